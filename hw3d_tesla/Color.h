@@ -1,6 +1,7 @@
 #pragma once
 #include <cmath>
 #include <assert.h>
+#include <cstdlib>
 
 // Surface is just a buffer of Colors (dword-style)
 class Color
@@ -53,13 +54,13 @@ public:
         {
             hueRad += twoPI;
         }
-        float hue = std::fmodf(hueRad * (180.0f / PI), 360.0f);
+        float hue = std::fmod(hueRad * (180.0f / PI), 360.0f);
 
         assert(hue >= 0.0f);
         assert(hue < 360.0f);
 
         const float c = value * saturation;
-        const float magic = 1.0f - std::abs(std::fmodf(hue / 60.0f, 2.0f) - 1.0f);
+        const float magic = 1.0f - std::abs(std::fmod(hue / 60.0f, 2.0f) - 1.0f);
         const float x = c * magic;
         const float m = value - c;
 
@@ -141,6 +142,16 @@ public:
     {
         dword = (dword & 0xFFFFFF00u) | b;
     }
+    // Scale r, g and b by the X byte, as the Alpha blend mode expects
+    constexpr Color Premultiplied() const noexcept
+    {
+        auto Scale = [a = (unsigned int)GetX()](unsigned int c)
+        {
+            const unsigned int t = c * a + 128u;
+            return (t + (t >> 8u)) >> 8u;
+        };
+        return Color((dword & 0xFF000000u) | (Scale(GetR()) << 16u) | (Scale(GetG()) << 8u) | Scale(GetB()));
+    }
 public:
     enum
     {
@@ -3,6 +3,7 @@
 #include "imgui\imgui_impl_dx11.h"
 #include "imgui\imgui_impl_win32.h"
 #include <d3dcompiler.h>
+#include <utility>
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "d3dcompiler.lib")
@@ -25,6 +26,7 @@
 
 Graphics::Graphics(HWND hWnd)
 	:
+	Rasterizer(pBuffer),
 	pBuffer(ScreenWidth, ScreenHeight),
 	msr({})
 {	
@@ -273,63 +275,45 @@ float Graphics::GetFrameRate() const noexcept
 	return frameRate;
 }
 
-void Graphics::DrawHLine(int xStart, int xEnd, int y, Color c)
+// A composed frame waiting for the presentation thread: the changed regions of the
+// framebuffer and a deep copy of the ImGui draw lists (ImGui reuses its own next frame)
+struct Graphics::PresentFrame
 {
-	assert(xStart <= xEnd && "Bad horizontal line endpoints");
-	if (clip)
+	PresentFrame()
+		:
+		buffer(ScreenWidth, ScreenHeight)
+	{}
+	~PresentFrame()
 	{
-		xStart = std::max(0, xStart);
-		xEnd   = std::min(static_cast<int>(ScreenWidth - 1), xEnd);
-		if (y < 0 || y > static_cast<int>(ScreenHeight - 1))
-		{
-			return;
-		}
+		ReleaseDrawLists();
 	}
-	for (int x = xStart; x <= xEnd; x++)
+	void ReleaseDrawLists() noexcept
 	{
-		PutPixel(x, y, c);
-	}
-}
-
-void Graphics::DrawVLine(int yStart, int yEnd, int x, Color c)
-{
-	assert(yStart <= yEnd && "Bad vertical line endpoints");
-	if (clip)
-	{
-		yStart = std::max(0, yStart);
-		yEnd   = std::min(static_cast<int>(ScreenHeight - 1), yEnd);
-		if (x < 0 || x > static_cast<int>(ScreenWidth - 1))
+		for (ImDrawList* pList : drawLists)
 		{
-			return;
+			IM_DELETE(pList);
 		}
+		drawLists.clear();
 	}
-	for (int y = yStart; y <= yEnd; y++)
-	{
-		PutPixel(x, y, c);
-	}
-}
-
-void Graphics::DrawHLine(float xStart, float xEnd, float y, Color c)
-{
-	DrawHLine(static_cast<int>(xStart), static_cast<int>(xEnd), static_cast<int>(y), c);
-}
-
-void Graphics::DrawVLine(float yStart, float yEnd, float x, Color c)
-{
-	DrawVLine(static_cast<int>(yStart), static_cast<int>(yEnd), static_cast<int>(x), c);
-}
+	Surface buffer;
+	std::vector<Surface::Rect> regions;
+	ImDrawData drawData;
+	std::vector<ImDrawList*> drawLists;
+	bool imGui = false;
+	UINT syncInterval = 1u;
+	bool ready = false;
+};
 
 Graphics::~Graphics()
 {
+	DisablePipelinedPresentation();
 	ImGui_ImplDX11_Shutdown();
 }
 
 void Graphics::BeginFrame(bool clear, Color clearColor)
 {
-	if (clear)
-	{
-		Clear(clearColor);
-	}
+	// Clears only what was drawn since the last clear, when possible
+	BeginDirtyFrame(clear, clearColor);
 	// We always do an ImGui NewFrame because of the useful framerate counter 
 	ImGui_ImplDX11_NewFrame();
 	ImGui_ImplWin32_NewFrame();
@@ -338,1213 +322,224 @@ void Graphics::BeginFrame(bool clear, Color clearColor)
 
 void Graphics::EndFrame()
 {
-	HRESULT hr;
-
 	UpdateFrameStatistics();
 
-	// Update the framebuffer stored in the GPU memory with our color pBuffer 
-	GFX_THROW_INFO_ONLY(pContext->UpdateSubresource(pTexture.Get(), 0u, nullptr, pBuffer.GetBufferPtrConst(), (UINT)pBuffer.GetRowPitch(), 0u));
-
-	// Draw the CPU Frame Buffer
-	GFX_THROW_INFO_ONLY(pContext->Draw(6u, 0u));
+	// Resolve the triangles still waiting in the tile bins
+	Flush();
 
-	// Render ImGui data on the screen only if it's enabled
 	ImGui::Render();
-	if (imGuiEnabled)
-	{
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
-	}
 
-#ifndef NDEBUG
-	infoManager.Set();
-#endif
-	if (FAILED(hr = pSwapChain->Present(syncInterval, 0u)))
+	if (!pipelined)
 	{
-		if (hr == DXGI_ERROR_DEVICE_REMOVED)
-		{
-			throw GFX_DEVICE_REMOVED_EXCEPT(hr);
-		}
-		else
-		{
-			throw GFX_EXCEPT(hr);
-		}
+		Present(pBuffer, GetDirtyRegions(), imGuiEnabled ? ImGui::GetDrawData() : nullptr, syncInterval);
+		return;
 	}
-}
-
-void Graphics::Clear(Color c) noexcept
-{
-	pBuffer.Clear(c);
-}
-
-void Graphics::EnableVSync() noexcept
-{
-	syncInterval = 1u;
-}
-
-void Graphics::DisableVSync() noexcept
-{
-	syncInterval = 0u;
-}
-
-void Graphics::SetVSyncInterval(const UINT verticalSyncInterval) noexcept
-{
-	syncInterval = verticalSyncInterval;
-}
-
-bool Graphics::IsVSyncEnabled() const noexcept
-{
-	return syncInterval != 0u;
-}
 
-void Graphics::EnableImGui() noexcept
-{
-	imGuiEnabled = true;
-}
-
-void Graphics::DisableImGui() noexcept
-{
-	imGuiEnabled = false;
-}
-
-bool Graphics::IsImGuiEnabled() const noexcept
-{
-	return imGuiEnabled;
-}
-
-void Graphics::EnableClipping() noexcept
-{
-	clip = true;
-}
-
-void Graphics::DisableClipping() noexcept
-{
-	clip = false;
-}
-
-bool Graphics::IsClippingEnabled() const noexcept
-{
-	return clip;
-}
-
-Color* Graphics::GetFramebufferPtr() const noexcept
-{
-	return pBuffer.GetBufferPtr();
-}
-
-const Color* Graphics::GetFramebufferPtrConst() const noexcept
-{
-	return pBuffer.GetBufferPtrConst();
-}
-
-void Graphics::PutPixel(int x, int y, Color c)
-{
-	pBuffer.PutPixel(x, y, c);
-}
-
-void Graphics::PutPixel(const Tesla::Vec2& p, Color c)
-{
-	PutPixel((int)p.x, (int)p.y, c);
-}
-
-void Graphics::PutPixel(const Tesla::Vei2& p, Color c)
-{
-	PutPixel(p.x, p.y, c);
-}
-
-void Graphics::PutPixel(int x, int y, unsigned char r, unsigned char g, unsigned char b)
-{
-	PutPixel(x, y, Color(r, g, b));
-}
-
-void Graphics::DrawLine(int x0, int y0, int x1, int y1, Color c)
-{
-	DrawLine(static_cast<float>(x0), static_cast<float>(y0), static_cast<float>(x1), static_cast<float>(y1), c);
-}
-
-void Graphics::DrawLine(float x0, float y0, float x1, float y1, Color c)
-{
-	auto Draw = [&](float x0, float y0, float x1, float y1)
-	{
-		const float side = std::max(std::abs(y1 - y0), std::abs(x1 - x0));
-		const int nPixels = (int)side;
-		const float sideInv = 1.0f / side;
-		const float dx = (x1 - x0) * sideInv;
-		const float dy = (y1 - y0) * sideInv;
-
-		// Prestep
-		float x = x0 + 0.5f;
-		float y = y0 + 0.5f;
-		for (int i = 0; i <= nPixels; i++)
-		{
-			PutPixel((int)x, (int)y, c);
-			x += dx;
-			y += dy;
-		}
-	};
-
-	if (clip)
+	// Wait for the oldest frame in flight to be presented, its buffer is the next one to fill
+	PresentFrame& frame = *presentFrames[nextFrameToFill];
+	std::exception_ptr error;
 	{
-		// Clip rectangle (off by -1, lol)
-		static constexpr float xmin = -1.0f;
-		static constexpr float ymin = -1.0f;
-		static constexpr float xmax = (float)Graphics::ScreenWidth  - 1.0f;
-		static constexpr float ymax = (float)Graphics::ScreenHeight - 1.0f;
-
-		static constexpr int INSIDE = 0;  // 0000
-		static constexpr int LEFT   = 1;  // 0001
-		static constexpr int RIGHT  = 2;  // 0010
-		static constexpr int BOTTOM = 4;  // 0100
-		static constexpr int TOP    = 8;  // 1000
-
-		typedef int OutCode;
-
-		auto ComputeOutCode = [&](float x, float y)
-		{
-			OutCode code;
-
-			code = INSIDE;          // initialised as being inside of [[clip window]]
-
-			if (x < xmin)           // to the left of clip window
-				code |= LEFT;
-			else if (x > xmax)      // to the right of clip window
-				code |= RIGHT;
-			if (y < ymin)           // below the clip window
-				code |= BOTTOM;
-			else if (y > ymax)      // above the clip window
-				code |= TOP;
-
-			return code;
-		};
-
-		// compute outcodes for P0, P1, and whatever point lies outside the clip rectangle
-		OutCode outcode0 = ComputeOutCode(x0, y0);
-		OutCode outcode1 = ComputeOutCode(x1, y1);
-		bool accept = false;
-
-		while (true)
-		{
-			if (!(outcode0 | outcode1))
-			{
-				// bitwise OR is 0: both points inside window; trivially accept and exit loop
-				accept = true;
-				break;
-			}
-			else if (outcode0 & outcode1)
-			{
-				// bitwise AND is not 0: both points share an outside zone (LEFT, RIGHT, TOP,
-				// or BOTTOM), so both must be outside window; exit loop (accept is false)
-				break;
-			}
-			else
-			{
-				// failed both tests, so calculate the line segment to clip
-				// from an outside point to an intersection with clip edge
-				float x = 0.0f, y = 0.0f;
-
-				// At least one endpoint is outside the clip rectangle; pick it.
-				OutCode outcodeOut = outcode1 > outcode0 ? outcode1 : outcode0;
-
-				// Now find the intersection point;
-				// use formulas:
-				//   slope = (y1 - y0) / (x1 - x0)
-				//   x = x0 + (1 / slope) * (ym - y0), where ym is ymin or ymax
-				//   y = y0 + slope * (xm - x0), where xm is xmin or xmax
-				// No need to worry about divide-by-zero because, in each case, the
-				// outcode bit being tested guarantees the denominator is non-zero
-				if (outcodeOut & TOP)  // point is above the clip window
-				{
-					x = x0 + (x1 - x0) * (ymax - y0) / (y1 - y0);
-					y = ymax;
-				}
-				else if (outcodeOut & BOTTOM)  // point is below the clip window
-				{
-					x = x0 + (x1 - x0) * (ymin - y0) / (y1 - y0);
-					y = ymin;
-				}
-				else if (outcodeOut & RIGHT)  // point is to the right of clip window
-				{
-					y = y0 + (y1 - y0) * (xmax - x0) / (x1 - x0);
-					x = xmax;
-				}
-				else if (outcodeOut & LEFT)  // point is to the left of clip window
-				{
-					y = y0 + (y1 - y0) * (xmin - x0) / (x1 - x0);
-					x = xmin;
-				}
-
-				// Now we move outside point to intersection point to clip
-				// and get ready for next pass.
-				if (outcodeOut == outcode0)
-				{
-					x0 = x;
-					y0 = y;
-					outcode0 = ComputeOutCode(x0, y0);
-				}
-				else
-				{
-					x1 = x;
-					y1 = y;
-					outcode1 = ComputeOutCode(x1, y1);
-				}
-			}
-		}
-
-		if (accept)
-		{
-			// Finally draw the clipped line with AdrianTesla's algorithm
-			Draw(x0, y0, x1, y1);
-		}
+		std::unique_lock<std::mutex> lock(presentMutex);
+		presentCv.wait(lock, [&] { return !frame.ready || presentError; });
+		error = std::exchange(presentError, nullptr);
 	}
-	else
+	if (error)
 	{
-		Draw(x0, y0, x1, y1);
+		// The presentation thread is gone: the next frames are presented from this thread
+		DisablePipelinedPresentation();
+		std::rethrow_exception(error);
 	}
-}
 
-void Graphics::DrawLine(int x0, int y0, int x1, int y1, Color c0, Color c1)
-{
-	DrawLine(static_cast<float>(x0), static_cast<float>(y0), static_cast<float>(x1), static_cast<float>(y1), c0, c1);
-}
-
-void Graphics::DrawLine(float x0, float y0, float x1, float y1, Color c0, Color c1)
-{
-	using namespace Tesla;
-	typedef unsigned char uc;
-
-	auto Draw = [&](float x0, float y0, float x1, float y1, const Vec3& vc0, const Vec3 vc1)
+	// The presentation thread doesn't touch a frame that is not ready
+	frame.regions = GetDirtyRegions();
+	for (const Surface::Rect& rect : frame.regions)
 	{
-		const float side = std::max(std::abs(y1 - y0), std::abs(x1 - x0));
-		const int nPixels = (int)side;
-		const float sideInv = 1.0f / side;
-		const float dx = (x1 - x0) * sideInv;
-		const float dy = (y1 - y0) * sideInv;
-		const Vec3 dvc = (vc1 - vc0) * sideInv;
-
-		Vec3 vc = vc0;
-
-		// Prestep
-		float x = x0 + 0.5f;
-		float y = y0 + 0.5f;
-		for (int i = 0; i <= nPixels; i++)
-		{
-			PutPixel((int)x, (int)y, Color((uc)vc.x, (uc)vc.y, (uc)vc.z));
-			x += dx;
-			y += dy;
-			vc += dvc;
-		}
-	};
-
-	Vec3 vc0 = Vec3((uc)c0.GetR(), (uc)c0.GetG(), (uc)c0.GetB());
-	Vec3 vc1 = Vec3((uc)c1.GetR(), (uc)c1.GetG(), (uc)c1.GetB());
-
-	if (clip)
+		frame.buffer.Copy(pBuffer, rect);
+	}
+	frame.ReleaseDrawLists();
+	frame.imGui = imGuiEnabled;
+	if (imGuiEnabled)
 	{
-		// Clip rectangle (off by -1, lol)
-		static constexpr float xmin = -1.0f;
-		static constexpr float ymin = -1.0f;
-		static constexpr float xmax = (float)Graphics::ScreenWidth - 1.0f;
-		static constexpr float ymax = (float)Graphics::ScreenHeight - 1.0f;
-
-		static constexpr int INSIDE = 0;  // 0000
-		static constexpr int LEFT = 1;  // 0001
-		static constexpr int RIGHT = 2;  // 0010
-		static constexpr int BOTTOM = 4;  // 0100
-		static constexpr int TOP = 8;  // 1000
-
-		typedef int OutCode;
-
-		auto ComputeOutCode = [&](float x, float y)
+		const ImDrawData* pDrawData = ImGui::GetDrawData();
+		for (int i = 0; i < pDrawData->CmdListsCount; i++)
 		{
-			OutCode code;
-
-			code = INSIDE;          // initialised as being inside of [[clip window]]
-
-			if (x < xmin)           // to the left of clip window
-				code |= LEFT;
-			else if (x > xmax)      // to the right of clip window
-				code |= RIGHT;
-			if (y < ymin)           // below the clip window
-				code |= BOTTOM;
-			else if (y > ymax)      // above the clip window
-				code |= TOP;
-
-			return code;
-		};
-
-		// compute outcodes for P0, P1, and whatever point lies outside the clip rectangle
-		OutCode outcode0 = ComputeOutCode(x0, y0);
-		OutCode outcode1 = ComputeOutCode(x1, y1);
-		bool accept = false;
-
-		while (true)
-		{
-			if (!(outcode0 | outcode1))
-			{
-				// bitwise OR is 0: both points inside window; trivially accept and exit loop
-				accept = true;
-				break;
-			}
-			else if (outcode0 & outcode1)
-			{
-				// bitwise AND is not 0: both points share an outside zone (LEFT, RIGHT, TOP,
-				// or BOTTOM), so both must be outside window; exit loop (accept is false)
-				break;
-			}
-			else
-			{
-				// failed both tests, so calculate the line segment to clip
-				// from an outside point to an intersection with clip edge
-				float x = 0.0f, y = 0.0f;
-				Vec3 vc_clip = { 0.0f,0.0f,0.0f };
-
-				// At least one endpoint is outside the clip rectangle; pick it.
-				OutCode outcodeOut = outcode1 > outcode0 ? outcode1 : outcode0;
-
-				// Now find the intersection point;
-				// use formulas:
-				//   slope = (y1 - y0) / (x1 - x0)
-				//   x = x0 + (1 / slope) * (ym - y0), where ym is ymin or ymax
-				//   y = y0 + slope * (xm - x0), where xm is xmin or xmax
-				// No need to worry about divide-by-zero because, in each case, the
-				// outcode bit being tested guarantees the denominator is non-zero
-				if (outcodeOut & TOP)  // point is above the clip window
-				{
-					const float t = (ymax - y0) / (y1 - y0);
-
-					x = x0 + (x1 - x0) * t;
-					vc_clip = vc0 + (vc1 - vc0) * t;
-					y = ymax;
-				}
-				else if (outcodeOut & BOTTOM)  // point is below the clip window
-				{
-					const float t = (ymin - y0) / (y1 - y0);
-
-					x = x0 + (x1 - x0) * t;
-					vc_clip = vc0 + (vc1 - vc0) * t;
-					y = ymin;
-				}
-				else if (outcodeOut & RIGHT)  // point is to the right of clip window
-				{
-					const float t = (xmax - x0) / (x1 - x0);
-					y = y0 + (y1 - y0) * t;
-					vc_clip = vc0 + (vc1 - vc0) * t;
-					x = xmax;
-				}
-				else if (outcodeOut & LEFT)  // point is to the left of clip window
-				{
-					const float t = (xmin - x0) / (x1 - x0);
-					y = y0 + (y1 - y0) * t;
-					vc_clip = vc0 + (vc1 - vc0) * t;
-					x = xmin;
-				}
-
-				// Now we move outside point to intersection point to clip
-				// and get ready for next pass.
-				if (outcodeOut == outcode0)
-				{
-					x0 = x;
-					y0 = y;
-					vc0 = vc_clip;
-					outcode0 = ComputeOutCode(x0, y0);
-				}
-				else
-				{
-					x1 = x;
-					y1 = y;
-					vc1 = vc_clip;
-					outcode1 = ComputeOutCode(x1, y1);
-				}
-			}
-		}
-
-		if (accept)
-		{
-			// Finally draw the clipped line with AdrianTesla's algorithm
-			Draw(x0, y0, x1, y1, vc0, vc1);
+			frame.drawLists.push_back(pDrawData->CmdLists[i]->CloneOutput());
 		}
+		frame.drawData = *pDrawData;
+		frame.drawData.CmdLists = frame.drawLists.data();
 	}
-	else
-	{
-		Draw(x0, y0, x1, y1, vc0, vc1);
-	}
-}
-
-void Graphics::DrawLine(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c)
-{
-	DrawLine(p0.x, p0.y, p1.x, p1.y, c);
-}
-
-void Graphics::DrawLine(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c0, Color c1)
-{
-	DrawLine(p0.x, p0.y, p1.x, p1.y, c0, c1);
-}
-
-void Graphics::DrawRect(float left, float right, float top, float bottom, Color c)
-{
-	DrawRect(static_cast<int>(left), static_cast<int>(right), static_cast<int>(top), static_cast<int>(bottom), c);
-}
+	frame.syncInterval = syncInterval;
 
-void Graphics::DrawRect(int left, int right, int top, int bottom, Color c)
-{
-	assert(left <= right && "Bad left and right drawing the int rect");
-	assert(top <= bottom && "Bad top and bottom drawing the int rect");
-	DrawHLine(left, right, top, c);
-	DrawHLine(left, right, bottom, c);
-	if (bottom - top > 1)
 	{
-		top++;
-		bottom--;
-		DrawVLine(top, bottom, left,  c);
-		DrawVLine(top, bottom, right, c);
+		std::lock_guard<std::mutex> lock(presentMutex);
+		frame.ready = true;
 	}
+	presentCv.notify_all();
+	nextFrameToFill = (nextFrameToFill + 1u) % (unsigned int)presentFrames.size();
 }
 
-void Graphics::DrawRect(const Tesla::Vec2& topLeft, float width, float height, Color c)
+void Graphics::EnablePipelinedPresentation(unsigned int nBuffers)
 {
-	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
-}
+	assert(nBuffers >= 2u && nBuffers <= 3u && "Pipelined presentation needs 2 or 3 framebuffers");
+	DisablePipelinedPresentation();
 
-void Graphics::DrawRect(const Tesla::Vei2& topLeft, int width, int height, Color c)
-{
-	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
-}
-
-void Graphics::DrawRectDim(float topLeftX, float topLeftY, float width, float height, Color c)
-{
-	DrawRectDim(static_cast<int>(topLeftX), static_cast<int>(topLeftY), static_cast<int>(width), static_cast<int>(height), c);
-}
-
-void Graphics::DrawRectDim(int topLeftX, int topLeftY, int width, int height, Color c)
-{
-	DrawRect(topLeftX, topLeftX + width - 1, topLeftY, topLeftY + height - 1, c);
-}
-
-void Graphics::DrawRectDim(const Tesla::Vec2& topLeft, float width, float height, Color c)
-{
-	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
-}
-
-void Graphics::DrawRectDim(const Tesla::Vei2& topLeft, int width, int height, Color c)
-{
-	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
-}
-
-void Graphics::FillRect(float left, float right, float top, float bottom, Color c)
-{
-	FillRect(static_cast<int>(left), static_cast<int>(right), static_cast<int>(top), static_cast<int>(bottom), c);
-}
-
-void Graphics::FillRect(int left, int right, int top, int bottom, Color c)
-{
-	assert(left <= right);
-	assert(top <= bottom);
-	if (clip)
+	// pBuffer is always the one being composed, the others are in flight
+	presentFrames.clear();
+	for (unsigned int i = 1u; i < nBuffers; i++)
 	{
-		left   = std::max(left, 0);
-		top    = std::max(top , 0);
-		right  = std::min(right , static_cast<int>(ScreenWidth  - 1));
-		bottom = std::min(bottom, static_cast<int>(ScreenHeight - 1));
+		presentFrames.push_back(std::make_unique<PresentFrame>());
 	}
-	for (int y = top; y <= bottom; y++)
-	{
-		for (int x = left; x <= right; x++)
-		{
-			PutPixel(x, y, c);
-		}
-	}
-}
-
-void Graphics::FillRect(const Tesla::Vec2& topLeft, float width, float height, Color c)
-{
-	FillRectDim(static_cast<int>(topLeft.x), static_cast<int>(topLeft.y), static_cast<int>(width), static_cast<int>(height), c);
-}
-
-void Graphics::FillRect(const Tesla::Vei2& topLeft, int width, int height, Color c)
-{
-	FillRectDim(topLeft.x, topLeft.y, width, height, c);
-}
-
-void Graphics::FillRectDim(float topLeftX, float topLeftY, float width, float height, Color c)
-{
-	FillRectDim(static_cast<int>(topLeftX), static_cast<int>(topLeftY), static_cast<int>(width), static_cast<int>(height), c);
+	nextFrameToFill = 0u;
+	nextFrameToPresent = 0u;
+	presentRunning = true;
+	presentError = nullptr;
+	presentThread = std::thread(&Graphics::PresentLoop, this);
+	pipelined = true;
 }
 
-void Graphics::FillRectDim(int topLeftX, int topLeftY, int width, int height, Color c)
+void Graphics::DisablePipelinedPresentation()
 {
-	FillRect(topLeftX, topLeftX + width - 1, topLeftY, topLeftY + height - 1, c);
-}
-
-void Graphics::FillRectDim(const Tesla::Vec2& topLeft, float width, float height, Color c)
-{
-	FillRectDim(static_cast<int>(topLeft.x), static_cast<int>(topLeft.y), static_cast<int>(width), static_cast<int>(height), c);
-}
-
-void Graphics::FillRectDim(const Tesla::Vei2& topLeft, int width, int height, Color c)
-{
-	FillRectDim(topLeft.x, topLeft.y, width, height, c);
-}
-
-void Graphics::DrawRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c)
-{
-	assert(nSides > 1 && "What is a regular polygon with less than 2 sides?");
-	using namespace Tesla;
-	const float phiStep = twoPI / float(nSides);
-	float phi = phiStep - rotationRad;
-
-	auto CalculatePosition = [&](float phi)
-	{
-		return Vec2(x + radius * std::cosf(phi), y + radius * std::sinf(phi));
-	};
-
-	Vec2 cur = CalculatePosition(-rotationRad);
-	for (int i = 0; i < nSides; i++)
+	if (!pipelined)
 	{
-		const Vec2 next = CalculatePosition(phi);
-		DrawLine(cur, next, c);
-		cur = next;
-		phi += phiStep;
+		return;
 	}
-}
-
-void Graphics::FillRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c)
-{
-	FillRegularPolygon({ x,y }, nSides, radius, rotationRad, c);
-}
-
-void Graphics::FillRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c_int, Color c_ext, bool rainbowMode)
-{
-	FillRegularPolygon({ x,y }, nSides, radius, rotationRad, c_int, c_ext, rainbowMode);
-}
-
-void Graphics::DrawRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c)
-{
-	DrawRegularPolygon(center.x, center.y, nSides, radius, rotationRad, c);
-}
-
-void Graphics::FillRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c)
-{
-	assert(nSides > 2 && "What is a regular polygon with less than 3 sides?");
-	using namespace Tesla;
-	const float phiStep = twoPI / float(nSides);
-	float phi = phiStep - rotationRad;
-
-	auto CalculatePosition = [&](float phi)
+	// The frames already handed over are still presented before the thread exits
 	{
-		return center + radius * Vec2(std::cosf(phi), std::sinf(phi));
-	};
-
-	Vec2 cur = CalculatePosition(-rotationRad);
-	for (int i = 0; i < nSides; i++)
-	{
-		const Vec2 next = CalculatePosition(phi);
-		FillTriangle(center, cur, next, c);
-		cur = next;
-		phi += phiStep;
+		std::lock_guard<std::mutex> lock(presentMutex);
+		presentRunning = false;
 	}
+	presentCv.notify_all();
+	presentThread.join();
+	pipelined = false;
+	presentFrames.clear();
 }
 
-void Graphics::FillRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c_int, Color c_ext, bool rainbowMode)
+bool Graphics::IsPipelinedPresentationEnabled() const noexcept
 {
-	assert(nSides > 2 && "What is a regular polygon with less than 3 sides?");
-	using namespace Tesla;
-	const float phiStep = twoPI / float(nSides);
-	float phi = phiStep - rotationRad;
-
-	auto CalculatePosition = [&](float phi)
-	{
-		return center + radius * Vec2(std::cosf(phi), std::sinf(phi));
-	};
-
-	Vec2 cur = CalculatePosition(-rotationRad);
-	if (rainbowMode)
-	{
-		for (int i = 0; i < nSides; i++)
-		{
-			const Vec2 next = CalculatePosition(phi);
-			FillTriangle(center, cur, next, c_int, Color::FromHSV(phi + rotationRad), Color::FromHSV(phi + rotationRad + phiStep));
-			cur = next;
-			phi += phiStep;
-		}
-	}
-	else
-	{
-		for (int i = 0; i < nSides; i++)
-		{
-			const Vec2 next = CalculatePosition(phi);
-			FillTriangle(center, cur, next, c_int, c_ext, c_ext);
-			cur = next;
-			phi += phiStep;
-		}
-	}
+	return pipelined;
 }
 
-void Graphics::DrawPolyline(const std::vector<Tesla::Vec2>& points, Color c)
+void Graphics::PresentLoop()
 {
-	if (points.size() > 1)
+	// From here on, only this thread uses the device context
+	while (true)
 	{
-		for (auto i = points.cbegin(), end = std::prev(points.end()); i < end; i++)
+		PresentFrame& frame = *presentFrames[nextFrameToPresent];
 		{
-			DrawLine(*i, *std::next(i), c);
+			std::unique_lock<std::mutex> lock(presentMutex);
+			presentCv.wait(lock, [&] { return frame.ready || !presentRunning; });
+			if (!frame.ready)
+			{
+				return;
+			}
 		}
-	}
-}
 
-void Graphics::DrawPolyline(const std::vector<Tesla::Vec2>& points, Color c0, Color c1)
-{
-	if (points.size() > 1)
-	{
-		using namespace Tesla;
-
-		if (points.size() == 2)
+		try
 		{
-			DrawLine(points[0], points[1], c0, c1);
+			Present(frame.buffer, frame.regions, frame.imGui ? &frame.drawData : nullptr, frame.syncInterval);
 		}
-		else
+		catch (...)
 		{
-			const Vec3 vc0 = Vec3(float(c0.GetR()), float(c0.GetG()), float(c0.GetB()));
-			const Vec3 vc1 = Vec3(float(c1.GetR()), float(c1.GetG()), float(c1.GetB()));
-
-			auto col = [](const Vec3& vc)
-			{
-				typedef unsigned char uc;
-				return Color((uc)vc.x, (uc)vc.y, (uc)vc.z);
-			};
-
-			const Vec3 dvc = (vc1 - vc0) / float(points.size() - 1);
-
-			Vec3 vc_cur = vc0;
-			Vec3 vc_next = vc0 + dvc;
-			for (auto i = points.cbegin(), end = std::prev(points.end()); i < end; i++)
+			// Handed to the game thread, which rethrows it from EndFrame(). The frames still
+			// in flight are dropped, nothing would present them
+			std::lock_guard<std::mutex> lock(presentMutex);
+			presentError = std::current_exception();
+			for (auto& pFrame : presentFrames)
 			{
-				DrawLine(*i, *std::next(i), col(vc_cur), col(vc_next));
-
-				vc_cur = vc_next;
-				vc_next += dvc;
+				pFrame->ready = false;
 			}
+			presentCv.notify_all();
+			return;
 		}
-	}
-}
 
-void Graphics::DrawClosedPolyline(const std::vector<Tesla::Vec2>& points, Color c)
-{
-	if (points.size() > 1)
-	{
-		DrawPolyline(points, c);
-		DrawLine(*std::prev(points.end()), *points.begin(), c);
+		{
+			std::lock_guard<std::mutex> lock(presentMutex);
+			frame.ready = false;
+		}
+		presentCv.notify_all();
+		nextFrameToPresent = (nextFrameToPresent + 1u) % (unsigned int)presentFrames.size();
 	}
 }
 
-void Graphics::DrawCircle(float xc, float yc, float radius, Color c)
-{
-	DrawEllipse(xc, yc, radius, radius, c);
-}
-
-void Graphics::DrawCircle(const Tesla::Vec2& center, float radius, Color c)
+void Graphics::Present(const Surface& buffer, std::span<const Surface::Rect> regions, ImDrawData* pDrawData, UINT interval)
 {
-	DrawCircle(center.x, center.y, radius, c);
-}
-
-void Graphics::FillCircle(float xc, float yc, float radius, Color c)
-{
-	FillEllipse(xc, yc, radius, radius, c);
-}
-
-void Graphics::FillCircle(const Tesla::Vec2& center, float radius, Color c)
-{
-	FillCircle(center.x, center.y, radius, c);
-}
-
-void Graphics::DrawEllipse(float xc, float yc, float ra, float rb, Color c)
-{
-	using namespace Tesla;
-
-	static constexpr int nSides = 100;
-	const float phiStep = twoPI / float(nSides);
-	
-	float phi = phiStep;
-
-	auto CalculatePosition = [&](float phi)
-	{
-		return Vec2(xc + ra * std::cosf(phi), yc + rb * std::sinf(phi));
-	};
+	HRESULT hr;
 
-	Vec2 cur = CalculatePosition(0.0f);
-	for (int i = 0; i < nSides; i++)
+	// Update the framebuffer stored in the GPU memory with the regions of the buffer changed this frame
+	for (const Surface::Rect& rect : regions)
 	{
-		const Vec2 next = CalculatePosition(phi);
-		DrawLine(cur, next, c);
-		cur = next;
-		phi += phiStep;
+		const D3D11_BOX box = { (UINT)rect.left,(UINT)rect.top,0u,(UINT)rect.right,(UINT)rect.bottom,1u };
+		GFX_THROW_INFO_ONLY(pContext->UpdateSubresource(pTexture.Get(), 0u, &box, buffer.GetRowPtr(rect.top) + rect.left, (UINT)buffer.GetRowPitch(), 0u));
 	}
-}
-
-void Graphics::DrawEllipse(const Tesla::Vec2& center, float ra, float rb, Color c)
-{
-	DrawEllipse(center.x, center.y, ra, rb, c);
-}
 
-void Graphics::FillEllipse(float xc, float yc, float ra, float rb, Color c)
-{
-	using namespace Tesla;
-	const int yStart = std::max((int)(yc - rb + 0.5f), 0);
-	const int yEnd   = std::min((int)(yc + rb + 0.5f), int(ScreenHeight - 1));
-	const float raSq = sq(ra);
-	const float rbSqInv = 1.0f / sq(rb);
+	// Draw the CPU Frame Buffer
+	GFX_THROW_INFO_ONLY(pContext->Draw(6u, 0u));
 
-	for (int y = yStart; y <= yEnd; y++)
+	// Render ImGui data on the screen only if it's enabled
+	if (pDrawData)
 	{
-		const float arg = 1.0f - rbSqInv * sq(static_cast<float>(y) - yc + 0.5f);
-		if (arg >= 0)
-		{
-			const float x_displacement = ra * std::sqrtf(arg);
-
-			const int xStart = std::max(int(xc - x_displacement + 0.5f), 0);
-			const int xEnd   = std::min(int(xc + x_displacement + 0.5f), int(ScreenWidth - 1));
-
-			for (int x = xStart; x <= xEnd; x++)
-			{
-				PutPixel(x, y, c);
-			}
-		}
+		ImGui_ImplDX11_RenderDrawData(pDrawData);
 	}
-}
-
-void Graphics::FillEllipse(const Tesla::Vec2& center, float ra, float rb, Color c)
-{
-	FillEllipse(center.x, center.y, ra, rb, c);
-}
-
-void Graphics::DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c)
-{
-	DrawTriangle({ x0,y0 }, { x1,y1 }, { x1,x2 }, c);
-}
-
-void Graphics::DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c0, Color c1, Color c2)
-{
-	DrawLine(x0, y0, x1, y1, c0, c1);
-	DrawLine(x1, y1, x2, y2, c1, c2);
-	DrawLine(x2, y2, x0, y0, c2, c0);
-}
-
-void Graphics::DrawTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c)
-{
-	DrawLine(v0, v1, c);
-	DrawLine(v1, v2, c);
-	DrawLine(v2, v0, c);
-}
-
-void Graphics::DrawTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c0, Color c1, Color c2)
-{
-	DrawTriangle(v0.x, v0.y, v1.x, v1.y, v2.x, v2.y, c0, c1, c2);
-}
 
-void Graphics::FillTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c)
-{
-	// Power
-	using namespace Tesla; 
-
-	// AABB - Aligned Axis Bounding Box, clipped
-	const int xStart = std::max(static_cast<int>(std::min({ v0.x,v1.x,v2.x })), 0);
-	const int yStart = std::max(static_cast<int>(std::min({ v0.y,v1.y,v2.y })), 0);
-	const int xEnd   = std::min(static_cast<int>(std::max({ v0.x,v1.x,v2.x })), static_cast<int>(ScreenWidth) - 1);
-	const int yEnd   = std::min(static_cast<int>(std::max({ v0.y,v1.y,v2.y })), static_cast<int>(ScreenHeight) - 1);
-
-	// Normalized side vectors (also accounts for CW/CCW triangle vertices)
-	const float areaInv = 1.0f / Vec2::Cross(v0 - v1, v2 - v1);
-	const Vec2 s01 = (v1 - v0) * areaInv;
-	const Vec2 s12 = (v2 - v1) * areaInv;
-	const Vec2 s20 = (v0 - v2) * areaInv;
-	
-	// Starting point
-	const Vec2 p = { float(xStart)+0.5f,float(yStart)+0.5f };
-
-	// First row barycentric coordinates
-	float w0_row = Vec2::Cross(p - v1, s12);
-	float w1_row = Vec2::Cross(p - v2, s20);
-	float w2_row = Vec2::Cross(p - v0, s01);
-
-	// y-loop
-	for (int y = yStart; y <= yEnd; y++)
+#ifndef NDEBUG
+	infoManager.Set();
+#endif
+	if (FAILED(hr = pSwapChain->Present(interval, 0u)))
 	{
-		// Barycentric coordinates at the start of the row
-		float w0 = w0_row;
-		float w1 = w1_row;
-		float w2 = w2_row;
-
-		// x-loop
-		for (int x = xStart; x <= xEnd; x++)
+		if (hr == DXGI_ERROR_DEVICE_REMOVED)
 		{
-			// Only draw pixels with positive Barycentric coordinates (inside triangle)
-			if ((w0 >= 0.0f) && (w1 >= 0.0f) && (w2 >= 0.0f))
-			{
-				// Here, (w0, w1, w2) are the normalized barycentric coordinates 
-				// of the triangle, limited to the [0, 1] interval
-				PutPixel(x, y, c);
-			}
-			// Update barycentric coordinates one pixel to the right
-			w0 += s12.y;
-			w1 += s20.y;
-			w2 += s01.y;
+			throw GFX_DEVICE_REMOVED_EXCEPT(hr);
+		}
+		else
+		{
+			throw GFX_EXCEPT(hr);
 		}
-		// Update barycentric coordinates one pixel down
-		w0_row -= s12.x;
-		w1_row -= s20.x;
-		w2_row -= s01.x;
 	}
 }
 
-void Graphics::FillTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c)
+void Graphics::EnableVSync() noexcept
 {
-	FillTriangle({ x0,y0 }, { x1,y1 }, { x2,y2 }, c);
+	syncInterval = 1u;
 }
 
-void Graphics::FillTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c0, Color c1, Color c2)
+void Graphics::DisableVSync() noexcept
 {
-	using namespace Tesla;
-
-	// AABB - Aligned Axis Bounding Box, clipped
-	const int xStart = std::max(static_cast<int>(std::min({ v0.x,v1.x,v2.x })), 0);
-	const int yStart = std::max(static_cast<int>(std::min({ v0.y,v1.y,v2.y })), 0);
-	const int xEnd   = std::min(static_cast<int>(std::max({ v0.x,v1.x,v2.x })), static_cast<int>(ScreenWidth) - 1);
-	const int yEnd   = std::min(static_cast<int>(std::max({ v0.y,v1.y,v2.y })), static_cast<int>(ScreenHeight) - 1);
-
-	// Normalized side vectors (also accounts for CW/CCW triangle vertices)
-	const float areaInv = 1.0f / Vec2::Cross(v0 - v1, v2 - v1);
-	const Vec2 s01 = (v1 - v0) * areaInv;
-	const Vec2 s12 = (v2 - v1) * areaInv;
-	const Vec2 s20 = (v0 - v2) * areaInv;
-
-	// Starting point
-	const Vec2 p = { float(xStart) + 0.5f,float(yStart) + 0.5f };
-
-	// First row barycentric coordinates
-	float w0_row = Vec2::Cross(p - v1, s12);
-	float w1_row = Vec2::Cross(p - v2, s20);
-	float w2_row = Vec2::Cross(p - v0, s01);
-
-	// Color to Vec3 for easy interpolation
-	const Vec3 vc0 = { float(c0.GetR()),float(c0.GetG()),float(c0.GetB()) };
-	const Vec3 vc1 = { float(c1.GetR()),float(c1.GetG()),float(c1.GetB()) };
-	const Vec3 vc2 = { float(c2.GetR()),float(c2.GetG()),float(c2.GetB()) };
-
-	// The color at the start, 
-	// and the linear change amount per pixel step (horizontal and vertical)
-	Vec3 c_row = vc0 * w0_row + vc1 * w1_row + vc2 * w2_row;
-	Vec3 dcx   = vc0 * s12.x  + vc1 * s20.x  + vc2 * s01.x;
-	Vec3 dcy   = vc0 * s12.y  + vc1 * s20.y  + vc2 * s01.y;
-
-	// y-loop
-	for (int y = yStart; y <= yEnd; y++)
-	{
-		// Barycentric coordiantes at the start of the row
-		float w0 = w0_row;
-		float w1 = w1_row;
-		float w2 = w2_row;
-
-		// Color at the start of the row
-		Vec3   c = c_row;
-
-		// x-loop
-		for (int x = xStart; x <= xEnd; x++)
-		{
-			// Only draw pixels with positive Barycentric coordinates (inside triangle)
-			if ((w0 >= 0.0f) && (w1 >= 0.0f) && (w2 >= 0.0f))
-			{
-				PutPixel(x, y, Color((unsigned char)c.x, (unsigned char)c.y, (unsigned char)c.z));
-			}
-			// Update barycentric coordinates and color for one step to the right
-			w0 += s12.y;
-			w1 += s20.y;
-			w2 += s01.y;
-			c  += dcy;
-		}
-		// Update barycentric coordinates at the start of the row and color for one step down
-		w0_row -= s12.x;
-		w1_row -= s20.x;
-		w2_row -= s01.x;
-		c_row  -= dcx;
-	}
+	syncInterval = 0u;
 }
 
-void Graphics::FillTriangle(const Tesla::Vec2& v0, Color c0, const Tesla::Vec2& v1, Color c1, const Tesla::Vec2& v2, Color c2)
+void Graphics::SetVSyncInterval(const UINT verticalSyncInterval) noexcept
 {
-	FillTriangle(v0, v1, v2, c0, c1, c2);
+	syncInterval = verticalSyncInterval;
 }
 
-void Graphics::FillTriangleTex(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, const Tesla::Vec2& uv0, const Tesla::Vec2& uv1, const Tesla::Vec2& uv2, const Surface& tex)
+bool Graphics::IsVSyncEnabled() const noexcept
 {
-	using namespace Tesla;
-
-	// AABB - Aligned Axis Bounding Box, clipped
-	const int xStart = std::max(static_cast<int>(std::min({ v0.x,v1.x,v2.x })), 0);
-	const int yStart = std::max(static_cast<int>(std::min({ v0.y,v1.y,v2.y })), 0);
-	const int xEnd   = std::min(static_cast<int>(std::max({ v0.x,v1.x,v2.x })), static_cast<int>(ScreenWidth) - 1);
-	const int yEnd   = std::min(static_cast<int>(std::max({ v0.y,v1.y,v2.y })), static_cast<int>(ScreenHeight) - 1);
-
-	// Normalized side vectors (also accounts for CW/CCW triangle vertices)
-	const float areaInv = 1.0f / Vec2::Cross(v0 - v1, v2 - v1);
-	const Vec2 s01 = (v1 - v0) * areaInv;
-	const Vec2 s12 = (v2 - v1) * areaInv;
-	const Vec2 s20 = (v0 - v2) * areaInv;
-
-	// Starting point
-	const Vec2 p = { float(xStart) + 0.5f,float(yStart) + 0.5f };
-
-	// First row barycentric coordinates
-	float w0_row = Vec2::Cross(p - v1, s12);
-	float w1_row = Vec2::Cross(p - v2, s20);
-	float w2_row = Vec2::Cross(p - v0, s01);
-
-	// The uv coords at the start, 
-	// and the linear change amount per pixel step (horizontal and vertical)
-	Vec2 uv_row = uv0 * w0_row + uv1 * w1_row + uv2 * w2_row;
-	Vec2 duvx   = uv0 * s12.x  + uv1 * s20.x  + uv2 * s01.x;
-	Vec2 duvy   = uv0 * s12.y  + uv1 * s20.y  + uv2 * s01.y;
-
-	// y-loop
-	for (int y = yStart; y <= yEnd; y++)
-	{
-		// Barycentric coordiantes at the start of the row
-		float w0 = w0_row;
-		float w1 = w1_row;
-		float w2 = w2_row;
-
-		// uv-coords at the start of the row
-		Vec2  uv = uv_row;
-
-		// x-loop
-		for (int x = xStart; x <= xEnd; x++)
-		{
-			// Only draw pixels with positive Barycentric coordinates (inside triangle)
-			if ((w0 >= 0.0f) && (w1 >= 0.0f) && (w2 >= 0.0f))
-			{
-				PutPixel(x, y, tex.Sample(uv.x, uv.y));
-			}
-			// Update barycentric coordinates and uv for one step to the right
-			w0 += s12.y;
-			w1 += s20.y;
-			w2 += s01.y;
-			uv += duvy;
-		}
-		// Update barycentric coordinates at the start of the row and uv for one step to the right
-		w0_row -= s12.x;
-		w1_row -= s20.x;
-		w2_row -= s01.x;
-		uv_row -= duvx;
-	}
+	return syncInterval != 0u;
 }
 
-void Graphics::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, Color c)
+void Graphics::EnableImGui() noexcept
 {
-	// QUADRATIC VERSION
-	// 
-	// Barozzi rules. Period.
-	// 1 = ((1 - t) + t)^2 =
-	// 1 = (1 - t)^2 + 2(1 - t) t + t^2
-	// 1 = b0(t) + b1(t) + b2(t)
-	// b0(t), b1(t), b2(t) sono i polinomi di Bernstein
-	// Una parametrizzazione della curva di Bezier  data da
-	// p(t) = b0(t) * p0 + b1(t) * p1 + b2(t) * p2
-
-	using namespace Tesla;
-
-	// How many?
-	const int nPoints = 100;
-	float t = 0.0f;
-	const float dt = 1.0f / float(nPoints);
-
-	// Not fully optimized, but sexy as hell
-	Vec2 cur = p0;
-	for (int i = 0; i <= nPoints; i++)
-	{
-		// Bernstein coefficients
-		const float b0 = sq(1.0f - t);
-		const float b1 = 2.0f * (1.0f - t) * t;
-		const float b2 = sq(t);
-
-		// Interpolate the points with the Bernstein coefficients
-		const Vec2 next = p0 * b0 + p1 * b1 + p2 * b2;
-
-		DrawLine(cur, next, c);
-		cur = next;
-		t += dt;
-	}
+	imGuiEnabled = true;
 }
 
-void Graphics::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, Color c0, Color c2)
+void Graphics::DisableImGui() noexcept
 {
-	// QUADRATIC VERSION, COLOR INTERPOLATION
-	// 
-	// Barozzi rules. Period.
-	// 1 = ((1 - t) + t)^2 =
-	// 1 = (1 - t)^2 + 2(1 - t) t + t^2
-	// 1 = b0(t) + b1(t) + b2(t)
-	// b0(t), b1(t), b2(t) sono i polinomi di Bernstein
-	// Una parametrizzazione della curva di Bezier  data da
-	// p(t) = b0(t) * p0 + b1(t) * p1 + b2(t) * p2
-
-	using namespace Tesla;
-
-	// How many?
-	const int nPoints = 100;
-	float t = 0.0f;
-	const float dt = 1.0f / float(nPoints);
-
-	// Use vector of floats for easy interpolation
-	const Vec3 vc0 = { (float)c0.GetR(),(float)c0.GetG(),(float)c0.GetB() };
-	const Vec3 vc2 = { (float)c2.GetR(),(float)c2.GetG(),(float)c2.GetB() };
-	const Vec3 dvc = (vc2 - vc0) * dt;
-	Vec3 vc = vc0;
-
-	// Not fully optimized, but sexy as hell
-	Vec2 cur = p0;
-	for (int i = 0; i <= nPoints; i++)
-	{
-		// Bernstein coefficients
-		const float b0 = sq(1.0f - t);
-		const float b1 = 2.0f * (1.0f - t) * t;
-		const float b2 = sq(t);
-
-		// Interpolate the points with the Bernstein coefficients
-		const Vec2 next = p0 * b0 + p1 * b1 + p2 * b2;
-
-		DrawLine(cur, next, Color((unsigned char)vc.x, (unsigned char)vc.y, (unsigned char)vc.z));
-		cur = next;
-
-		t  += dt;
-		vc += dvc;
-	}
+	imGuiEnabled = false;
 }
 
-void Graphics::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, Color c)
+bool Graphics::IsImGuiEnabled() const noexcept
 {
-	// CUBIC VERSION
-	//
-	// Barozzi rules. Period.
-	// 1 = ((1 - t) + t)^3 =
-	// 1 = (1 - t)^3 + 3(1 - t)^2 t + 3(1 - t) t^2 + t^3
-	// 1 = b0(t) + b1(t) + b2(t) + b3(t)
-	// b0(t), b1(t), b2(t), b3(t) sono i polinomi di Bernstein
-	// Una parametrizzazione della curva di Bezier  data da
-	// p(t) = b0(t) * p0 + b1(t) * p1 + b2(t) * p2 + b3(t) * p3;
-
-	using namespace Tesla;
-
-	// How many?
-	const int nPoints = 100;
-	float t = 0.0f;
-	const float dt = 1.0f / float(nPoints);
-
-	// Not fully optimized, but sexy as hell
-	Vec2 cur = p0;
-	for (int i = 0; i <= nPoints; i++)
-	{
-		// Bernstein coefficients
-		const float b0 = cube(1.0f - t);
-		const float b1 = 3.0f * sq(1.0f - t) * t;
-		const float b2 = 3.0f * (1.0f - t) * sq(t);
-		const float b3 = cube(t);
-
-		// Interpolate the points with the Bernstein coefficients
-		const Vec2 next = p0 * b0 + p1 * b1 + p2 * b2 + p3 * b3;
-
-		DrawLine(cur, next, c);
-		cur = next;
-		t += dt;
-	}
+	return imGuiEnabled;
 }
 
-void Graphics::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, Color c0, Color c3)
+Color* Graphics::GetFramebufferPtr() const noexcept
 {
-	// CUBIC VERSION, COLOR INTERPOLATION
-	//
-	// Barozzi rules. Period.
-	// 1 = ((1 - t) + t)^3 =
-	// 1 = (1 - t)^3 + 3(1 - t)^2 t + 3(1 - t) t^2 + t^3
-	// 1 = b0(t) + b1(t) + b2(t) + b3(t)
-	// b0(t), b1(t), b2(t), b3(t) sono i polinomi di Bernstein
-	// Una parametrizzazione della curva di Bezier  data da
-	// p(t) = b0(t) * p0 + b1(t) * p1 + b2(t) * p2 + b3(t) * p3;
-
-	using namespace Tesla;
-
-	// How many?
-	const int nPoints = 100;
-
-	// Vec3 colors for easy interpolation
-	const Vec3 vc0 = { (float)c0.GetR(),(float)c0.GetG(),(float)c0.GetB() };
-	const Vec3 vc3 = { (float)c3.GetR(),(float)c3.GetG(),(float)c3.GetB() };
-	
-	const float dt = 1.0f / float(nPoints);
-	const Vec3 dvc = (vc3 - vc0) * dt;
-
-	float t = 0.0f;
-	Vec3 vc = vc0;
-
-	// Not fully optimized, but sexy as hell
-	Vec2 cur = p0;
-	for (int i = 0; i <= nPoints; i++)
-	{
-		// Bernstain coefficients
-		const float b0 = cube(1.0f - t);
-		const float b1 = 3.0f * sq(1.0f - t) * t;
-		const float b2 = 3.0f * (1.0f - t) * sq(t);
-		const float b3 = cube(t);
-
-		// Interpolate the points with the Bernstain coefficients
-		const Vec2 next = p0 * b0 + p1 * b1 + p2 * b2 + p3 * b3;
-
-		DrawLine(cur, next, Color((unsigned char)vc.x, (unsigned char)vc.y, (unsigned char)vc.z));
-		cur = next;
-		t += dt;
-		vc += dvc;
-	}
+	return pBuffer.GetBufferPtr();
 }
 
-void Graphics::DrawSPLine(const std::vector<Tesla::Vec2>& points, Color c)
+const Color* Graphics::GetFramebufferPtrConst() const noexcept
 {
-	// HIGHLY INEFFICIENT, WE HAVE TO IMPROVE.
-	// This is a cubic SPLine passing through every point
-	using namespace Tesla;
-
-	const size_t nPoints = points.size();
-	if(nPoints >= 2u)
-	{
-		std::vector<Vec2> p;
-
-		const Vec2 first = points[0ui64];
-		const Vec2 last = points[nPoints - 1ui64];
-
-		p.push_back(first);
-		for (auto& v : points)
-		{
-			p.push_back(v);
-		}
-		p.push_back(last);
-
-		const int nSegments = int(nPoints - 1);
-		for (int i = 0; i < nSegments; i++)
-		{
-			static constexpr int nSubd = 30;
-			float t = 0.0f;
-			const float dt = 1.0f / static_cast<float>(nSubd);
-			Vec2 cur = p[1ui64 + i];
-			for (int j = 0; j <= nSubd; j++)
-			{
-				const float b0 = -t * sq(1.0f - t);
-				const float b1 = (t - 1.0f) * (3.0f * sq(t) - 2.0f * t - 2);
-				const float b2 = -3.0f * cube(t) + 4.0f * sq(t) + t;
-				const float b3 = cube(t) - sq(t);
-
-				const Vec2 next = 0.5f * (p[i] * b0 + p[i + 1ui64] * b1 + p[i + 2ui64] * b2 + p[i + 3ui64] * b3);
-
-				DrawLine(cur, next, c);
-
-				t += dt;
-				cur = next;
-			}
-		}
-	}
+	return pBuffer.GetBufferPtrConst();
 }
 
 Graphics::HrException::HrException(int line, const char* file, HRESULT hr, std::vector<std::string> infoMsgs) noexcept
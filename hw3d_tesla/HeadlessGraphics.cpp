@@ -0,0 +1,42 @@
+#include "HeadlessGraphics.h"
+
+HeadlessGraphics::HeadlessGraphics(unsigned int width, unsigned int height)
+	:
+	Rasterizer(backBuffer),
+	frontBuffer(width, height),
+	backBuffer(width, height)
+{
+	frontBuffer.Clear(Color::Black);
+	backBuffer.Clear(Color::Black);
+}
+
+void HeadlessGraphics::BeginFrame(bool clear, Color clearColor)
+{
+	BeginDirtyFrame(clear, clearColor);
+}
+
+void HeadlessGraphics::EndFrame()
+{
+	Flush();
+	// "Present" only what changed, GetDirtyByteCount() tells how much that was
+	for (const Surface::Rect& rect : GetDirtyRegions())
+	{
+		frontBuffer.Copy(backBuffer, rect);
+	}
+	frameCount++;
+}
+
+const Surface& HeadlessGraphics::GetFrontBuffer() const noexcept
+{
+	return frontBuffer;
+}
+
+const Surface& HeadlessGraphics::GetBackBuffer() const noexcept
+{
+	return backBuffer;
+}
+
+unsigned long long HeadlessGraphics::GetFrameCount() const noexcept
+{
+	return frameCount;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "Rasterizer.h"
+
+// Windowless presentation backend for batch rendering: the Rasterizer draws into the
+// back buffer and EndFrame() copies its dirty regions to the front buffer, the same
+// rectangles Graphics uploads to the GPU (no vsync, no device)
+class HeadlessGraphics : public Rasterizer
+{
+public:
+	HeadlessGraphics(unsigned int width, unsigned int height);
+	HeadlessGraphics(const HeadlessGraphics&) = delete;
+	HeadlessGraphics& operator = (const HeadlessGraphics&) = delete;
+	~HeadlessGraphics() = default;
+public:
+	void BeginFrame(bool clear = true, Color clearColor = Color::Black);
+	void EndFrame();
+	// The last presented frame
+	const Surface& GetFrontBuffer() const noexcept;
+	// The frame currently being composed
+	const Surface& GetBackBuffer() const noexcept;
+	unsigned long long GetFrameCount() const noexcept;
+private:
+	Surface frontBuffer;
+	Surface backBuffer;
+	unsigned long long frameCount = 0u;
+};
@@ -0,0 +1,2664 @@
+#include "Rasterizer.h"
+#include <cmath>
+#include <array>
+
+// Integer division rounded down or up, for any signs
+static long long FloorDiv(long long a, long long b) noexcept
+{
+	return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+static long long CeilDiv(long long a, long long b) noexcept
+{
+	return -FloorDiv(-a, b);
+}
+
+Rasterizer::Rasterizer(Surface& renderTarget) noexcept
+	:
+	pTarget(&renderTarget),
+	partialKernels(GetRowKernels(false)),
+	coveredKernels(GetRowKernels(true)),
+	pFrameTarget(&renderTarget)
+{
+}
+
+void Rasterizer::SetRenderTarget(Surface& renderTarget)
+{
+	assert(renderTarget.GetLayout() == Surface::Layout::Linear && "Render targets must be linear");
+	Flush();
+	pTarget = &renderTarget;
+	// Only the frame target is tracked (once BeginDirtyFrame has sized the grid)
+	trackDirty = (pTarget == pFrameTarget) && !dirtyCells.empty();
+}
+
+Surface& Rasterizer::GetRenderTarget() const noexcept
+{
+	return *pTarget;
+}
+
+int Rasterizer::GetTargetWidth() const noexcept
+{
+	return static_cast<int>(pTarget->GetWidth());
+}
+
+int Rasterizer::GetTargetHeight() const noexcept
+{
+	return static_cast<int>(pTarget->GetHeight());
+}
+
+void Rasterizer::Clear(Color c) noexcept
+{
+	// Whatever is still queued would be cleared anyway
+	tileQueue.clear();
+	for (auto& bin : tileBins)
+	{
+		bin.clear();
+	}
+	pTarget->Clear(c);
+	if (trackDirty)
+	{
+		MarkDirty({ 0,0,GetTargetWidth(),GetTargetHeight() });
+	}
+}
+
+void Rasterizer::ClearRect(const Surface::Rect& rect, Color c)
+{
+	Flush();
+	pTarget->ClearRect(rect, c);
+	if (trackDirty)
+	{
+		MarkDirty(rect);
+	}
+}
+
+void Rasterizer::ClearRegions(std::span<const Surface::Rect> rects, Color c)
+{
+	Flush();
+	pTarget->ClearRegions(rects, c);
+	if (trackDirty)
+	{
+		for (const Surface::Rect& rect : rects)
+		{
+			MarkDirty(rect);
+		}
+	}
+}
+
+void Rasterizer::EnableClipping() noexcept
+{
+	clip = true;
+}
+
+void Rasterizer::DisableClipping() noexcept
+{
+	clip = false;
+}
+
+bool Rasterizer::IsClippingEnabled() const noexcept
+{
+	return clip;
+}
+
+void Rasterizer::SetBlendMode(Surface::BlendMode mode) noexcept
+{
+	blendMode = mode;
+}
+
+Surface::BlendMode Rasterizer::GetBlendMode() const noexcept
+{
+	return blendMode;
+}
+
+void Rasterizer::SetTextureFilter(Surface::Filter filter) noexcept
+{
+	textureFilter = filter;
+}
+
+Surface::Filter Rasterizer::GetTextureFilter() const noexcept
+{
+	return textureFilter;
+}
+
+void Rasterizer::SetTextureAddressMode(Surface::AddressMode mode) noexcept
+{
+	textureAddressMode = mode;
+}
+
+Surface::AddressMode Rasterizer::GetTextureAddressMode() const noexcept
+{
+	return textureAddressMode;
+}
+
+void Rasterizer::EnableTiledRasterization(unsigned int nThreads)
+{
+	Flush();
+	if (!pThreadPool || pThreadPool->GetThreadCount() != std::max(nThreads, 1u))
+	{
+		pThreadPool = std::make_unique<TeslaThreadPool>(nThreads);
+	}
+	tiled = true;
+}
+
+void Rasterizer::DisableTiledRasterization()
+{
+	Flush();
+	tiled = false;
+}
+
+bool Rasterizer::IsTiledRasterizationEnabled() const noexcept
+{
+	return tiled;
+}
+
+void Rasterizer::Flush()
+{
+	if (tileQueue.empty())
+	{
+		return;
+	}
+
+	// Every tile draws its own triangles in submission order, and no pixel
+	// belongs to two tiles, so the result is the same as the serial path
+	pThreadPool->ParallelFor((unsigned int)tileBins.size(), [this](unsigned int i)
+	{
+		const int x = (int(i) % nTilesX) * TileSize;
+		const int y = (int(i) / nTilesX) * TileSize;
+		for (const unsigned int index : tileBins[i])
+		{
+			RasterizeTriangle(tileQueue[index], x, y, x + TileSize - 1, y + TileSize - 1);
+		}
+	});
+
+	tileQueue.clear();
+	for (auto& bin : tileBins)
+	{
+		bin.clear();
+	}
+}
+
+void Rasterizer::MarkDirty(const Surface::Rect& rect) noexcept
+{
+	if (dirtyCells.empty())
+	{
+		return;
+	}
+	const int left   = std::max(rect.left, 0);
+	const int top    = std::max(rect.top, 0);
+	const int right  = std::min(rect.right, (int)pFrameTarget->GetWidth());
+	const int bottom = std::min(rect.bottom, (int)pFrameTarget->GetHeight());
+	if (left >= right || top >= bottom)
+	{
+		return;
+	}
+	for (int cy = top / DirtyCellSize; cy <= (bottom - 1) / DirtyCellSize; cy++)
+	{
+		unsigned char* const pRow = &dirtyCells[size_t(cy) * nDirtyCellsX];
+		for (int cx = left / DirtyCellSize; cx <= (right - 1) / DirtyCellSize; cx++)
+		{
+			pRow[cx] = Changed | Drawn;
+		}
+	}
+}
+
+void Rasterizer::MarkDirty(int x, int y) noexcept
+{
+	if (trackDirty && unsigned(x) < pTarget->GetWidth() && unsigned(y) < pTarget->GetHeight())
+	{
+		dirtyCells[size_t(y / DirtyCellSize) * nDirtyCellsX + x / DirtyCellSize] = Changed | Drawn;
+	}
+}
+
+void Rasterizer::BuildDirtyRegions(unsigned char flags)
+{
+	// Runs of flagged cells in every row of cells. A run extends the rectangle ending right
+	// above it when they span the same columns. Rectangles are clipped to the target
+	const int width  = (int)pFrameTarget->GetWidth();
+	const int height = (int)pFrameTarget->GetHeight();
+	dirtyRegions.clear();
+	std::vector<size_t> prevRow;
+	std::vector<size_t> curRow;
+	for (int cy = 0; cy < nDirtyCellsY; cy++)
+	{
+		const unsigned char* const pRow = &dirtyCells[size_t(cy) * nDirtyCellsX];
+		const int top    = cy * DirtyCellSize;
+		const int bottom = std::min(top + DirtyCellSize, height);
+		size_t candidate = 0;
+		for (int cx = 0; cx < nDirtyCellsX;)
+		{
+			if (!(pRow[cx] & flags))
+			{
+				cx++;
+				continue;
+			}
+			const int cxStart = cx;
+			while (cx < nDirtyCellsX && (pRow[cx] & flags))
+			{
+				cx++;
+			}
+			const int left  = cxStart * DirtyCellSize;
+			const int right = std::min(cx * DirtyCellSize, width);
+
+			// Both rows are sorted by left side
+			while (candidate < prevRow.size() && dirtyRegions[prevRow[candidate]].left < left)
+			{
+				candidate++;
+			}
+			if (candidate < prevRow.size() && dirtyRegions[prevRow[candidate]].left == left && dirtyRegions[prevRow[candidate]].right == right)
+			{
+				dirtyRegions[prevRow[candidate]].bottom = bottom;
+				curRow.push_back(prevRow[candidate]);
+			}
+			else
+			{
+				curRow.push_back(dirtyRegions.size());
+				dirtyRegions.push_back({ left,top,right,bottom });
+			}
+		}
+		std::swap(prevRow, curRow);
+		curRow.clear();
+	}
+}
+
+const std::vector<Surface::Rect>& Rasterizer::GetDirtyRegions()
+{
+	BuildDirtyRegions(Changed);
+	return dirtyRegions;
+}
+
+size_t Rasterizer::GetDirtyByteCount()
+{
+	size_t nPixels = 0;
+	for (const Surface::Rect& rect : GetDirtyRegions())
+	{
+		nPixels += size_t(rect.right - rect.left) * size_t(rect.bottom - rect.top);
+	}
+	return nPixels * sizeof(Color);
+}
+
+void Rasterizer::BeginDirtyFrame(bool clear, Color clearColor)
+{
+	if (dirtyCells.empty())
+	{
+		// Nothing is known about the first frame, everything has to go
+		nDirtyCellsX = ((int)pFrameTarget->GetWidth()  + DirtyCellSize - 1) / DirtyCellSize;
+		nDirtyCellsY = ((int)pFrameTarget->GetHeight() + DirtyCellSize - 1) / DirtyCellSize;
+		dirtyCells.assign(size_t(nDirtyCellsX) * nDirtyCellsY, Changed | Drawn);
+		trackDirty = (pTarget == pFrameTarget);
+	}
+
+	if (!clear)
+	{
+		// The frame target keeps its pixels, nothing has changed yet
+		Flush();
+		for (unsigned char& cell : dirtyCells)
+		{
+			cell &= ~Changed;
+		}
+		return;
+	}
+
+	// Whatever is still queued would be cleared anyway
+	tileQueue.clear();
+	for (auto& bin : tileBins)
+	{
+		bin.clear();
+	}
+
+	if (lastClearValid && clearColor.dword == lastClearColor.dword)
+	{
+		// Cells drawn since the last clear go back to the clear color (and have to be
+		// transferred once more), the others are already clear and unchanged
+		BuildDirtyRegions(Drawn);
+		pFrameTarget->ClearRegions(dirtyRegions, clearColor);
+		for (unsigned char& cell : dirtyCells)
+		{
+			cell = (cell & Drawn) ? (unsigned char)Changed : (unsigned char)0u;
+		}
+	}
+	else
+	{
+		pFrameTarget->Clear(clearColor);
+		std::fill(dirtyCells.begin(), dirtyCells.end(), (unsigned char)Changed);
+		lastClearValid = true;
+		lastClearColor = clearColor;
+	}
+}
+
+Color* Rasterizer::GetRowPtr(int y)
+{
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		MarkDirty({ 0,y,GetTargetWidth(),y + 1 });
+	}
+	return pTarget->GetRowPtr(y);
+}
+
+void Rasterizer::FillSpan(int y, int xStart, int xEnd, Color c)
+{
+	if (clip)
+	{
+		xStart = std::max(0, xStart);
+		xEnd   = std::min(GetTargetWidth(), xEnd);
+		if (y < 0 || y > GetTargetHeight() - 1 || xStart >= xEnd)
+		{
+			return;
+		}
+	}
+	assert(xStart >= 0 && xEnd <= GetTargetWidth() && "Attempting to draw outside the surface");
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		MarkDirty({ xStart,y,xEnd,y + 1 });
+	}
+	Surface::BlendSpan(pTarget->GetRowPtr(y), xStart, xEnd, c, blendMode);
+}
+
+void Rasterizer::DrawHLine(int xStart, int xEnd, int y, Color c)
+{
+	assert(xStart <= xEnd && "Bad horizontal line endpoints");
+	FillSpan(y, xStart, xEnd + 1, c);
+}
+
+void Rasterizer::DrawVLine(int yStart, int yEnd, int x, Color c)
+{
+	assert(yStart <= yEnd && "Bad vertical line endpoints");
+	if (clip)
+	{
+		yStart = std::max(0, yStart);
+		yEnd   = std::min(GetTargetHeight() - 1, yEnd);
+		if (x < 0 || x > GetTargetWidth() - 1)
+		{
+			return;
+		}
+	}
+	for (int y = yStart; y <= yEnd; y++)
+	{
+		PutPixel(x, y, c);
+	}
+}
+
+void Rasterizer::DrawHLine(float xStart, float xEnd, float y, Color c)
+{
+	DrawHLine(static_cast<int>(xStart), static_cast<int>(xEnd), static_cast<int>(y), c);
+}
+
+void Rasterizer::DrawVLine(float yStart, float yEnd, float x, Color c)
+{
+	DrawVLine(static_cast<int>(yStart), static_cast<int>(yEnd), static_cast<int>(x), c);
+}
+
+void Rasterizer::PutPixel(int x, int y, Color c)
+{
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	MarkDirty(x, y);
+	if (blendMode != Surface::BlendMode::Opaque)
+	{
+		c = Surface::Blend(pTarget->GetPixel(x, y), c, blendMode);
+	}
+	pTarget->PutPixel(x, y, c);
+}
+
+void Rasterizer::PutPixel(const Tesla::Vec2& p, Color c)
+{
+	PutPixel((int)p.x, (int)p.y, c);
+}
+
+void Rasterizer::PutPixel(const Tesla::Vei2& p, Color c)
+{
+	PutPixel(p.x, p.y, c);
+}
+
+void Rasterizer::PutPixel(int x, int y, unsigned char r, unsigned char g, unsigned char b)
+{
+	PutPixel(x, y, Color(r, g, b));
+}
+
+void Rasterizer::DrawLine(int x0, int y0, int x1, int y1, Color c)
+{
+	DrawLine(static_cast<float>(x0), static_cast<float>(y0), static_cast<float>(x1), static_cast<float>(y1), c);
+}
+
+void Rasterizer::DrawLine(float x0, float y0, float x1, float y1, Color c)
+{
+	Line line;
+	if (SetupLine(x0, y0, x1, y1, clip, line))
+	{
+		PrepareLine(line);
+		RasterizeLine(line, c);
+	}
+}
+
+void Rasterizer::RasterizeLine(const Line& line, Color c)
+{
+	// One step along the major axis, plus one row or column whenever the minor coordinate
+	// crosses into the next pixel
+	const int pitch       = GetTargetWidth();
+	const int majorStep   = line.xMajor ? line.majorDir : line.majorDir * pitch;
+	const int minorStep   = line.xMajor ? pitch : 1;
+	auto Walk = [&](auto Write)
+	{
+		Color* p = pTarget->GetBufferPtr() + (size_t)pitch * line.y + line.x;
+		long long minor = line.minor;
+		for (int i = line.iStart; i <= line.iEnd; i++)
+		{
+			Write(*p);
+			const long long minorNext = minor + line.dminor;
+			p += majorStep + int((minorNext >> 32) - (minor >> 32)) * minorStep;
+			minor = minorNext;
+		}
+	};
+	if (blendMode == Surface::BlendMode::Opaque)
+	{
+		Walk([c](Color& dst) { dst = c; });
+	}
+	else
+	{
+		Walk([c, mode = blendMode](Color& dst) { dst = Surface::Blend(dst, c, mode); });
+	}
+}
+
+void Rasterizer::DrawLine(int x0, int y0, int x1, int y1, Color c0, Color c1)
+{
+	DrawLine(static_cast<float>(x0), static_cast<float>(y0), static_cast<float>(x1), static_cast<float>(y1), c0, c1);
+}
+
+void Rasterizer::DrawLine(float x0, float y0, float x1, float y1, Color c0, Color c1)
+{
+	Line line;
+	if (SetupLine(x0, y0, x1, y1, clip, line))
+	{
+		PrepareLine(line);
+		RasterizeLine(line, c0, c1);
+	}
+}
+
+void Rasterizer::RasterizeLine(const Line& line, Color c0, Color c1)
+{
+	// The three channels in 8.12 fixed point, packed in one 64 bit integer with a guard bit
+	// above each of them: one add steps the whole color, and the carry that a negative
+	// increment pushes out of a channel dies in its guard bit
+	typedef unsigned long long ull;
+	static constexpr int fracBits  = 12;
+	static constexpr int laneBits  = 8 + fracBits;
+	static constexpr int laneShift = laneBits + 1;
+	static constexpr ull laneMask  = (ull(1) << laneBits) - 1u;
+	static constexpr ull colorMask = laneMask | (laneMask << laneShift) | (laneMask << (2 * laneShift));
+
+	// Increments are truncated toward zero, so no channel ever steps past the end color
+	ull color  = 0u;
+	ull dcolor = 0u;
+	const int channels0[3] = { c0.GetB(),c0.GetG(),c0.GetR() };
+	const int channels1[3] = { c1.GetB(),c1.GetG(),c1.GetR() };
+	for (int k = 0; k < 3; k++)
+	{
+		const int d     = line.length > 0.0f ? int(float((channels1[k] - channels0[k]) << fracBits) / line.length) : 0;
+		const int start = (channels0[k] << fracBits) + d * line.iStart;
+		color  |= (ull(start) & laneMask) << (k * laneShift);
+		dcolor |= (ull(d)     & laneMask) << (k * laneShift);
+	}
+
+	const int pitch       = GetTargetWidth();
+	const int majorStep   = line.xMajor ? line.majorDir : line.majorDir * pitch;
+	const int minorStep   = line.xMajor ? pitch : 1;
+	Color* p = pTarget->GetBufferPtr() + (size_t)pitch * line.y + line.x;
+	long long minor = line.minor;
+	for (int i = line.iStart; i <= line.iEnd; i++)
+	{
+		const unsigned int b = unsigned(color >> fracBits) & 0xFFu;
+		const unsigned int g = unsigned(color >> (laneShift + fracBits)) & 0xFFu;
+		const unsigned int r = unsigned(color >> (2 * laneShift + fracBits)) & 0xFFu;
+		*p = Color((r << 16u) | (g << 8u) | b);
+		color = (color + dcolor) & colorMask;
+		const long long minorNext = minor + line.dminor;
+		p += majorStep + int((minorNext >> 32) - (minor >> 32)) * minorStep;
+		minor = minorNext;
+	}
+}
+
+bool Rasterizer::SetupLine(float x0, float y0, float x1, float y1, bool clipLine, Line& line) const
+{
+	typedef long long ll;
+	x0 = std::clamp(x0, -GuardBand, GuardBand);
+	y0 = std::clamp(y0, -GuardBand, GuardBand);
+	x1 = std::clamp(x1, -GuardBand, GuardBand);
+	y1 = std::clamp(y1, -GuardBand, GuardBand);
+
+	// One pixel per step of the major axis, endpoints included, sampled at
+	// the pixel centers of the original float algorithm (prestep 0.5)
+	const float ax = std::abs(x1 - x0);
+	const float ay = std::abs(y1 - y0);
+	line.xMajor = ax >= ay;
+	line.length = std::max(ax, ay);
+	const int nSteps = (int)line.length;
+
+	const double majorStart = double(line.xMajor ? x0 : y0) + 0.5;
+	const double minorStart = double(line.xMajor ? y0 : x0) + 0.5;
+	const double majorDelta = double(line.xMajor ? x1 - x0 : y1 - y0);
+	const double minorDelta = double(line.xMajor ? y1 - y0 : x1 - x0);
+	line.majorDir = majorDelta < 0.0 ? -1 : 1;
+
+	// 32.32 fixed point position of step 0, and change for one step
+	const ll S_major = std::llround(majorStart * 4294967296.0);
+	const ll S_minor = std::llround(minorStart * 4294967296.0);
+	const ll D_major = ll(line.majorDir) << 32;
+	const ll D_minor = line.length > 0.0f ? std::llround(minorDelta / double(line.length) * 4294967296.0) : 0;
+
+	line.iStart = 0;
+	line.iEnd   = nSteps;
+	const ll majorLimit = (ll(line.xMajor ? GetTargetWidth() : GetTargetHeight()) << 32) - 1;
+	const ll minorLimit = (ll(line.xMajor ? GetTargetHeight() : GetTargetWidth()) << 32) - 1;
+	if (clipLine)
+	{
+		// Clip once: keep only the steps whose pixel is inside [0, limit] on both axes
+		auto ClipAxis = [&](ll S, ll D, ll limit)
+		{
+			if (D == 0)
+			{
+				if (S < 0 || S > limit)
+				{
+					line.iEnd = -1;
+				}
+				return;
+			}
+			const ll lo = (D > 0) ? CeilDiv(-S, D) : CeilDiv(limit - S, D);
+			const ll hi = (D > 0) ? FloorDiv(limit - S, D) : FloorDiv(-S, D);
+			line.iStart = (int)std::max<ll>(line.iStart, lo);
+			line.iEnd   = (int)std::min<ll>(line.iEnd, hi);
+		};
+		ClipAxis(S_major, D_major, majorLimit);
+		ClipAxis(S_minor, D_minor, minorLimit);
+		if (line.iStart > line.iEnd)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		assert(S_major >= 0 && S_major + D_major * nSteps <= majorLimit && "Attempting to draw outside the surface");
+		assert(S_minor >= 0 && S_minor + D_minor * nSteps <= minorLimit && "Attempting to draw outside the surface");
+	}
+
+	const int major = int((S_major + D_major * line.iStart) >> 32);
+	line.minor  = S_minor + D_minor * line.iStart;
+	line.dminor = D_minor;
+	line.x = line.xMajor ? major : int(line.minor >> 32);
+	line.y = line.xMajor ? int(line.minor >> 32) : major;
+	return true;
+}
+
+void Rasterizer::PrepareLine(const Line& line)
+{
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		// The pixel of the last step bounds the line together with the first one
+		const int nSteps   = line.iEnd - line.iStart;
+		const int majorEnd = (line.xMajor ? line.x : line.y) + line.majorDir * nSteps;
+		const int minorEnd = int((line.minor + line.dminor * nSteps) >> 32);
+		const int xEnd = line.xMajor ? majorEnd : minorEnd;
+		const int yEnd = line.xMajor ? minorEnd : majorEnd;
+		MarkDirty({ std::min(line.x, xEnd),std::min(line.y, yEnd),std::max(line.x, xEnd) + 1,std::max(line.y, yEnd) + 1 });
+	}
+}
+
+void Rasterizer::DrawLines(std::span<const LineSegment> segments, Color c)
+{
+	DrawLineBatch(segments, [c](size_t) { return c; });
+}
+
+void Rasterizer::DrawLines(std::span<const LineSegment> segments, std::span<const Color> colors)
+{
+	assert(colors.size() == segments.size() && "One color per segment expected");
+	DrawLineBatch(segments, [colors](size_t i) { return colors[i]; });
+}
+
+template<typename ColorOf>
+void Rasterizer::DrawLineBatch(std::span<const LineSegment> segments, ColorOf colorOf)
+{
+	if (!clip)
+	{
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			const LineSegment& s = segments[i];
+			Line line;
+			SetupLine(s.p0.x, s.p0.y, s.p1.x, s.p1.y, false, line);
+			PrepareLine(line);
+			RasterizeLine(line, colorOf(i));
+		}
+		return;
+	}
+
+	// Classify LineBatchSize segments at a time in SoA form, then only the ones
+	// crossing the border of the target go through the clipping setup
+	static const LineClassifier classify = GetLineClassifier();
+	const float width  = float(GetTargetWidth());
+	const float height = float(GetTargetHeight());
+	LineBatch batch;
+	for (size_t base = 0; base < segments.size(); base += LineBatchSize)
+	{
+		const int count = (int)std::min<size_t>(LineBatchSize, segments.size() - base);
+		for (int i = 0; i < count; i++)
+		{
+			const LineSegment& s = segments[base + i];
+			batch.x0[i] = s.p0.x;
+			batch.y0[i] = s.p0.y;
+			batch.x1[i] = s.p1.x;
+			batch.y1[i] = s.p1.y;
+		}
+		// The classifiers work on whole vectors of 8
+		for (int i = count; i < ((count + 7) & ~7); i++)
+		{
+			batch.x0[i] = batch.y0[i] = batch.x1[i] = batch.y1[i] = 0.0f;
+		}
+		classify(batch, count, width, height);
+
+		for (int i = 0; i < count; i++)
+		{
+			if (batch.cls[i] == LineClass::Rejected)
+			{
+				continue;
+			}
+			Line line;
+			if (SetupLine(batch.x0[i], batch.y0[i], batch.x1[i], batch.y1[i], batch.cls[i] == LineClass::Clipped, line))
+			{
+				PrepareLine(line);
+				RasterizeLine(line, colorOf(base + i));
+			}
+		}
+	}
+}
+
+void Rasterizer::DrawLine(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c)
+{
+	DrawLine(p0.x, p0.y, p1.x, p1.y, c);
+}
+
+void Rasterizer::DrawLine(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c0, Color c1)
+{
+	DrawLine(p0.x, p0.y, p1.x, p1.y, c0, c1);
+}
+
+void Rasterizer::DrawLineAA(float x0, float y0, float x1, float y1, Color c)
+{
+	typedef long long ll;
+	x0 = std::clamp(x0, -GuardBand, GuardBand);
+	y0 = std::clamp(y0, -GuardBand, GuardBand);
+	x1 = std::clamp(x1, -GuardBand, GuardBand);
+	y1 = std::clamp(y1, -GuardBand, GuardBand);
+
+	// Work in (major, minor) coordinates, walking the major axis forward
+	const bool steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+	if (steep)
+	{
+		std::swap(x0, y0);
+		std::swap(x1, y1);
+	}
+	if (x0 > x1)
+	{
+		std::swap(x0, x1);
+		std::swap(y0, y1);
+	}
+	const int pitch       = GetTargetWidth();
+	const int majorSize   = steep ? GetTargetHeight() : GetTargetWidth();
+	const int minorSize   = steep ? GetTargetWidth() : GetTargetHeight();
+	const int majorStride = steep ? pitch : 1;
+	const int minorStride = steep ? 1 : pitch;
+	const float gradient  = (x1 > x0) ? (y1 - y0) / (x1 - x0) : 0.0f;
+
+	// Pixel centers are on integer coordinates, as for DrawLine. The end pixels get the
+	// coverage of the part of the line inside their column (the gaps)
+	const float xEnd0 = std::floor(x0 + 0.5f);
+	const float xEnd1 = std::floor(x1 + 0.5f);
+	const float yEnd0 = y0 + gradient * (xEnd0 - x0);
+	const float yEnd1 = y1 + gradient * (xEnd1 - x1);
+	const float xGap0 = 1.0f - (x0 + 0.5f - xEnd0);
+	const float xGap1 = x1 + 0.5f - xEnd1;
+	const int majorStart = (int)xEnd0;
+	const int majorEnd   = (int)xEnd1;
+
+	// Clip the major axis once. The two minor pixels of a step are only tested when the
+	// line gets within a pixel of the border, which also covers the fixed point rounding
+	int first = majorStart;
+	int last  = majorEnd;
+	const int minorMin = (int)std::floor(std::min(yEnd0, yEnd1));
+	const int minorMax = (int)std::floor(std::max(yEnd0, yEnd1)) + 1;
+	if (clip)
+	{
+		first = std::max(first, 0);
+		last  = std::min(last, majorSize - 1);
+		if (first > last || minorMax < 0 || minorMin >= minorSize)
+		{
+			return;
+		}
+	}
+	else
+	{
+		// The pixel below the last row only ever gets zero coverage, it is skipped below
+		assert(majorStart >= 0 && majorEnd < majorSize && minorMin >= 0 && minorMax <= minorSize && "Attempting to draw outside the surface");
+	}
+	const bool checkMinor = minorMin <= 0 || minorMax >= minorSize - 1;
+
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		const int minorLo = std::max(minorMin - 1, 0);
+		const int minorHi = std::min(minorMax + 1, minorSize - 1);
+		MarkDirty(steep ? Surface::Rect{ minorLo,first,minorHi + 1,last + 1 } : Surface::Rect{ first,minorLo,last + 1,minorHi + 1 });
+	}
+
+	// Coverage goes into the X byte of the color as the alpha of the blend
+	Color* const pBuffer = pTarget->GetBufferPtr();
+	const unsigned int rgb = c.dword & 0xFFFFFFu;
+	auto Plot = [&](int major, int minor, unsigned int alpha)
+	{
+		if (checkMinor && unsigned(minor) >= unsigned(minorSize))
+		{
+			return;
+		}
+		Color& dst = pBuffer[ll(major) * majorStride + ll(minor) * minorStride];
+		dst = AlphaBlend(dst, Color(rgb | (alpha << 24u)));
+	};
+	auto PlotEnd = [&](int major, float y, float gap)
+	{
+		if (major >= first && major <= last)
+		{
+			const float yFloor = std::floor(y);
+			const float frac   = y - yFloor;
+			Plot(major, (int)yFloor, (unsigned int)((1.0f - frac) * gap * 255.0f + 0.5f));
+			Plot(major, (int)yFloor + 1, (unsigned int)(frac * gap * 255.0f + 0.5f));
+		}
+	};
+	PlotEnd(majorStart, yEnd0, xGap0);
+	if (majorEnd != majorStart)
+	{
+		PlotEnd(majorEnd, yEnd1, xGap1);
+	}
+
+	// Inner pixels: minor position in 32.32 fixed point, the top 8 bits of the
+	// fraction split the step between the two pixels it straddles
+	const int innerFirst = std::max(majorStart + 1, first);
+	const int innerLast  = std::min(majorEnd - 1, last);
+	const ll dminor = std::llround(double(gradient) * 4294967296.0);
+	ll minor = std::llround((double(yEnd0) + double(gradient) * (innerFirst - majorStart)) * 4294967296.0);
+	if (innerFirst > innerLast)
+	{
+		return;
+	}
+	if (checkMinor)
+	{
+		for (int major = innerFirst; major <= innerLast; major++, minor += dminor)
+		{
+			const int y = int(minor >> 32);
+			const unsigned int frac = unsigned(minor >> 24) & 0xFFu;
+			Plot(major, y, 255u - frac);
+			Plot(major, y + 1, frac);
+		}
+	}
+	else
+	{
+		// Both pixels are always inside: walk a pointer like DrawLine does
+		Color* p = pBuffer + ll(innerFirst) * majorStride + (minor >> 32) * minorStride;
+		for (int major = innerFirst; major <= innerLast; major++)
+		{
+			const unsigned int frac = unsigned(minor >> 24) & 0xFFu;
+			p[0]           = AlphaBlend(p[0], Color(rgb | ((255u - frac) << 24u)));
+			p[minorStride] = AlphaBlend(p[minorStride], Color(rgb | (frac << 24u)));
+			const ll minorNext = minor + dminor;
+			p += majorStride + int((minorNext >> 32) - (minor >> 32)) * minorStride;
+			minor = minorNext;
+		}
+	}
+}
+
+void Rasterizer::DrawLineAA(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c)
+{
+	DrawLineAA(p0.x, p0.y, p1.x, p1.y, c);
+}
+
+Color Rasterizer::AlphaBlend(Color dst, Color src) noexcept
+{
+	// dst + (src - dst) * alpha, red and blue in one multiply and green in another: the borrow a
+	// negative blue difference takes from red cancels out. Alpha 255 is bumped to 256 so it
+	// gives back src exactly. The X byte of dst is kept
+	const unsigned int a     = src.GetX() + (src.GetX() >> 7u);
+	const unsigned int dstRB = dst.dword & 0xFF00FFu;
+	const unsigned int dstG  = dst.dword & 0x00FF00u;
+	const unsigned int rb    = (dstRB + ((((src.dword & 0xFF00FFu) - dstRB) * a) >> 8u)) & 0xFF00FFu;
+	const unsigned int g     = (dstG  + ((((src.dword & 0x00FF00u) - dstG) * a) >> 8u)) & 0x00FF00u;
+	return Color((dst.dword & 0xFF000000u) | rb | g);
+}
+
+void Rasterizer::DrawRect(float left, float right, float top, float bottom, Color c)
+{
+	DrawRect(static_cast<int>(left), static_cast<int>(right), static_cast<int>(top), static_cast<int>(bottom), c);
+}
+
+void Rasterizer::DrawRect(int left, int right, int top, int bottom, Color c)
+{
+	assert(left <= right && "Bad left and right drawing the int rect");
+	assert(top <= bottom && "Bad top and bottom drawing the int rect");
+	DrawHLine(left, right, top, c);
+	DrawHLine(left, right, bottom, c);
+	if (bottom - top > 1)
+	{
+		top++;
+		bottom--;
+		DrawVLine(top, bottom, left,  c);
+		DrawVLine(top, bottom, right, c);
+	}
+}
+
+void Rasterizer::DrawRect(const Tesla::Vec2& topLeft, float width, float height, Color c)
+{
+	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
+}
+
+void Rasterizer::DrawRect(const Tesla::Vei2& topLeft, int width, int height, Color c)
+{
+	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
+}
+
+void Rasterizer::DrawRectDim(float topLeftX, float topLeftY, float width, float height, Color c)
+{
+	DrawRectDim(static_cast<int>(topLeftX), static_cast<int>(topLeftY), static_cast<int>(width), static_cast<int>(height), c);
+}
+
+void Rasterizer::DrawRectDim(int topLeftX, int topLeftY, int width, int height, Color c)
+{
+	DrawRect(topLeftX, topLeftX + width - 1, topLeftY, topLeftY + height - 1, c);
+}
+
+void Rasterizer::DrawRectDim(const Tesla::Vec2& topLeft, float width, float height, Color c)
+{
+	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
+}
+
+void Rasterizer::DrawRectDim(const Tesla::Vei2& topLeft, int width, int height, Color c)
+{
+	DrawRectDim(topLeft.x, topLeft.y, width, height, c);
+}
+
+void Rasterizer::FillRect(float left, float right, float top, float bottom, Color c)
+{
+	FillRect(static_cast<int>(left), static_cast<int>(right), static_cast<int>(top), static_cast<int>(bottom), c);
+}
+
+void Rasterizer::FillRect(int left, int right, int top, int bottom, Color c)
+{
+	assert(left <= right);
+	assert(top <= bottom);
+	if (clip)
+	{
+		left   = std::max(left, 0);
+		top    = std::max(top , 0);
+		right  = std::min(right , GetTargetWidth()  - 1);
+		bottom = std::min(bottom, GetTargetHeight() - 1);
+	}
+	for (int y = top; y <= bottom; y++)
+	{
+		FillSpan(y, left, right + 1, c);
+	}
+}
+
+void Rasterizer::FillRect(const Tesla::Vec2& topLeft, float width, float height, Color c)
+{
+	FillRectDim(static_cast<int>(topLeft.x), static_cast<int>(topLeft.y), static_cast<int>(width), static_cast<int>(height), c);
+}
+
+void Rasterizer::FillRect(const Tesla::Vei2& topLeft, int width, int height, Color c)
+{
+	FillRectDim(topLeft.x, topLeft.y, width, height, c);
+}
+
+void Rasterizer::FillRectDim(float topLeftX, float topLeftY, float width, float height, Color c)
+{
+	FillRectDim(static_cast<int>(topLeftX), static_cast<int>(topLeftY), static_cast<int>(width), static_cast<int>(height), c);
+}
+
+void Rasterizer::FillRectDim(int topLeftX, int topLeftY, int width, int height, Color c)
+{
+	FillRect(topLeftX, topLeftX + width - 1, topLeftY, topLeftY + height - 1, c);
+}
+
+void Rasterizer::FillRectDim(const Tesla::Vec2& topLeft, float width, float height, Color c)
+{
+	FillRectDim(static_cast<int>(topLeft.x), static_cast<int>(topLeft.y), static_cast<int>(width), static_cast<int>(height), c);
+}
+
+void Rasterizer::FillRectDim(const Tesla::Vei2& topLeft, int width, int height, Color c)
+{
+	FillRectDim(topLeft.x, topLeft.y, width, height, c);
+}
+
+const Rasterizer::PolygonRing& Rasterizer::GetPolygonRing(int nSides)
+{
+	// Vertex i of the unit ring is at angle i * 2pi / nSides, its rainbow color is the hue
+	// of the angle of vertex i + 1
+	PolygonRing& ring = polygonRings[nSides];
+	if (ring.unit.empty())
+	{
+		const double phiStep = Tesla::twoPI_D / double(nSides);
+		ring.unit.reserve(nSides);
+		ring.rainbow.reserve(nSides);
+		for (int i = 0; i < nSides; i++)
+		{
+			ring.unit.push_back({ float(std::cos(phiStep * i)),float(std::sin(phiStep * i)) });
+			const Color c = Color::FromHSV(float(phiStep * (i + 1)));
+			ring.rainbow.push_back({ (float)c.GetR(),(float)c.GetG(),(float)c.GetB() });
+		}
+	}
+	return ring;
+}
+
+void Rasterizer::BuildRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad)
+{
+	using namespace Tesla;
+	Mat2 m = Mat2::Rotation(-rotationRad);
+	for (auto& row : m.elements)
+	{
+		row[0] *= radius;
+		row[1] *= radius;
+	}
+	polygonVertices.clear();
+	for (const Vec2& u : GetPolygonRing(nSides).unit)
+	{
+		polygonVertices.push_back(center + Mat2::Mul(m, u));
+	}
+}
+
+void Rasterizer::DrawRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c)
+{
+	DrawRegularPolygon({ x,y }, nSides, radius, rotationRad, c);
+}
+
+void Rasterizer::FillRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c)
+{
+	FillRegularPolygon({ x,y }, nSides, radius, rotationRad, c);
+}
+
+void Rasterizer::FillRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c_int, Color c_ext, bool rainbowMode)
+{
+	FillRegularPolygon({ x,y }, nSides, radius, rotationRad, c_int, c_ext, rainbowMode);
+}
+
+void Rasterizer::DrawRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c)
+{
+	assert(nSides > 1 && "What is a regular polygon with less than 2 sides?");
+	BuildRegularPolygon(center, nSides, radius, rotationRad);
+	DrawClosedPolyline(polygonVertices, c);
+}
+
+void Rasterizer::FillRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c)
+{
+	assert(nSides > 2 && "What is a regular polygon with less than 3 sides?");
+	BuildRegularPolygon(center, nSides, radius, rotationRad);
+	FillPolygon(polygonVertices, c);
+}
+
+void Rasterizer::FillRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c_int, Color c_ext, bool rainbowMode)
+{
+	// The shading is the one of the fan of triangles (center, vertex i, vertex i + 1) with
+	// c_int at the center and c_ext (or the hue of the next vertex angle) on the vertices.
+	// Each wedge of the fan has its own linear gradient, so a row is cut where it crosses
+	// the rays through the vertices and every piece is stepped with its wedge gradient
+	assert(nSides > 2 && "What is a regular polygon with less than 3 sides?");
+	using namespace Tesla;
+	BuildRegularPolygon(center, nSides, radius, rotationRad);
+
+	// Wedge i: color = c_int + dcdx * dx + dcdy * dy from the center, solved from the
+	// colors of vertices i and i + 1. raySlope is dx / dy along the ray through vertex i
+	const std::vector<Vec3>& rainbow = GetPolygonRing(nSides).rainbow;
+	const Vec3 vc_int = { (float)c_int.GetR(),(float)c_int.GetG(),(float)c_int.GetB() };
+	const Vec3 vc_ext = { (float)c_ext.GetR(),(float)c_ext.GetG(),(float)c_ext.GetB() };
+	polygonWedges.clear();
+	for (int i = 0; i < nSides; i++)
+	{
+		const int iNext = i + 1 < nSides ? i + 1 : 0;
+		const Vec2 e0 = polygonVertices[i] - center;
+		const Vec2 e1 = polygonVertices[iNext] - center;
+		const Vec3 dc0 = (rainbowMode ? rainbow[i] : vc_ext) - vc_int;
+		const Vec3 dc1 = (rainbowMode ? rainbow[iNext] : vc_ext) - vc_int;
+		const float invDet = 1.0f / (e0.x * e1.y - e0.y * e1.x);
+		polygonWedges.push_back({ (dc0 * e1.y - dc1 * e0.y) * invDet,(dc1 * e0.x - dc0 * e1.x) * invDet,e0.x / e0.y });
+	}
+	// The wedge holding direction (dx, dy) from the center, searched from wedge i: a row
+	// starts a wedge or two away from where the row above started
+	auto FindWedge = [&](int i, float dx, float dy)
+	{
+		for (int n = 0; n < nSides; n++)
+		{
+			const int iNext = i + 1 < nSides ? i + 1 : 0;
+			const Vec2 e0 = polygonVertices[i] - center;
+			const Vec2 e1 = polygonVertices[iNext] - center;
+			if (e0.x * dy - e0.y * dx < 0.0f)
+			{
+				i = i > 0 ? i - 1 : nSides - 1;
+			}
+			else if (dx * e1.y - dy * e1.x < 0.0f)
+			{
+				i = iNext;
+			}
+			else
+			{
+				break;
+			}
+		}
+		return i;
+	};
+	int iRowStart = 0;
+
+	const bool opaque = blendMode == Surface::BlendMode::Opaque;
+	ScanPolygon(polygonVertices, FillRule::NonZero, [&](Color* pRow, int y, int xStart, int xEnd)
+	{
+		const float dy = float(y) + 0.5f - center.y;
+		int i = iRowStart = FindWedge(iRowStart, float(xStart) + 0.5f - center.x, dy);
+		int x = xStart;
+		while (x < xEnd)
+		{
+			// Going right the angle decreases below the center and increases above it,
+			// the piece ends where the row crosses the ray the angle is heading to. The
+			// row through the center jumps from angle pi to angle 0 at the center
+			const float dx = float(x) + 0.5f - center.x;
+			const int iNext = i + 1 < nSides ? i + 1 : 0;
+			const int iRay = dy > 0.0f ? i : iNext;
+			const float rayY = polygonVertices[iRay].y - center.y;
+			int xPieceEnd = xEnd;
+			if (dy == 0.0f)
+			{
+				if (dx < 0.0f)
+				{
+					xPieceEnd = (int)std::ceil(center.x - 0.5f);
+				}
+			}
+			else if (rayY * dy > 0.0f)
+			{
+				xPieceEnd = (int)std::ceil(center.x + dy * polygonWedges[iRay].raySlope - 0.5f);
+			}
+			xPieceEnd = std::clamp(xPieceEnd, x + 1, xEnd);
+
+			// Colors at the first and last pixel, stepped in 16.16 between them by the
+			// covered gradient row kernel
+			const PolygonWedge& wedge = polygonWedges[i];
+			const int count = xPieceEnd - x;
+			const Vec3 cFirst = vc_int + wedge.dcdx * dx + wedge.dcdy * dy;
+			const Vec3 cLast  = cFirst + wedge.dcdx * float(count - 1);
+			Triangle piece = {};
+			piece.type   = Triangle::Type::Gradient;
+			piece.xStart = x;
+			piece.yStart = y;
+			for (int k = 0; k < 3; k++)
+			{
+				const int first = int(std::clamp((&cFirst.x)[k], 0.0f, 255.0f) * 65536.0f);
+				const int last  = int(std::clamp((&cLast.x)[k], 0.0f, 255.0f) * 65536.0f);
+				piece.rgb[k]    = unsigned(first);
+				piece.drgbdx[k] = unsigned(count > 1 ? (last - first) / (count - 1) : 0);
+			}
+			if (opaque)
+			{
+				coveredKernels.gradient(piece, pRow, y, x, xPieceEnd - 1);
+			}
+			else
+			{
+				Color scratch[BlendScratchSize];
+				for (int x0 = x; x0 < xPieceEnd; x0 += BlendScratchSize)
+				{
+					const int x1 = std::min(xPieceEnd, x0 + BlendScratchSize) - 1;
+					coveredKernels.gradient(piece, scratch - x0, y, x0, x1);
+					Surface::BlendSpan(pRow + x0, scratch, x1 - x0 + 1, blendMode);
+				}
+			}
+			x = xPieceEnd;
+
+			if (dy > 0.0f)
+			{
+				i = i > 0 ? i - 1 : nSides - 1;
+			}
+			else if (dy < 0.0f)
+			{
+				i = iNext;
+			}
+			else
+			{
+				i = FindWedge(i, 1.0f, 0.0f);
+			}
+		}
+	});
+}
+
+void Rasterizer::FillPolygon(std::span<const Tesla::Vec2> vertices, Color c, FillRule rule)
+{
+	ScanPolygon(vertices, rule, [this, c](Color* pRow, int, int xStart, int xEnd)
+	{
+		Surface::BlendSpan(pRow, xStart, xEnd, c, blendMode);
+	});
+}
+
+template<typename SpanFunc>
+void Rasterizer::ScanPolygon(std::span<const Tesla::Vec2> vertices, FillRule rule, SpanFunc span)
+{
+	using namespace Tesla;
+	const size_t nVertices = vertices.size();
+	if (nVertices < 3u)
+	{
+		return;
+	}
+	// Edge table: the edges crossing at least one row center, sorted by their first row.
+	// Both directions of an edge are set up from its top, so the polygons sharing it
+	// split its pixels exactly
+	polygonEdges.clear();
+	float left  = vertices[0].x;
+	float right = vertices[0].x;
+	for (size_t i = 0; i < nVertices; i++)
+	{
+		const Vec2 v0 = { std::clamp(vertices[i].x, -GuardBand, GuardBand),std::clamp(vertices[i].y, -GuardBand, GuardBand) };
+		const Vec2& next = vertices[i + 1 < nVertices ? i + 1 : 0];
+		const Vec2 v1 = { std::clamp(next.x, -GuardBand, GuardBand),std::clamp(next.y, -GuardBand, GuardBand) };
+		left  = std::min(left, v0.x);
+		right = std::max(right, v0.x);
+		const bool down = v0.y < v1.y;
+		const Vec2& top    = down ? v0 : v1;
+		const Vec2& bottom = down ? v1 : v0;
+		int yStart = (int)std::ceil(top.y - 0.5f);
+		int yEnd   = (int)std::ceil(bottom.y - 0.5f);
+		if (clip)
+		{
+			yStart = std::max(yStart, 0);
+			yEnd   = std::min(yEnd, GetTargetHeight());
+		}
+		if (yStart < yEnd)
+		{
+			const double dxdy = (double(bottom.x) - top.x) / (double(bottom.y) - top.y);
+			polygonEdges.push_back({ yStart,yEnd,top.x + (yStart + 0.5 - top.y) * dxdy,dxdy,down ? 1 : -1 });
+		}
+	}
+	if (polygonEdges.empty())
+	{
+		return;
+	}
+	std::sort(polygonEdges.begin(), polygonEdges.end(), [](const PolygonEdge& a, const PolygonEdge& b)
+	{
+		return a.yStart < b.yStart;
+	});
+
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	int yEndMax = polygonEdges.front().yEnd;
+	for (const PolygonEdge& e : polygonEdges)
+	{
+		yEndMax = std::max(yEndMax, e.yEnd);
+	}
+	if (trackDirty)
+	{
+		MarkDirty({ (int)std::floor(left),polygonEdges.front().yStart,(int)std::ceil(right) + 1,yEndMax });
+	}
+
+	auto IsInside = [rule](int winding)
+	{
+		return rule == FillRule::EvenOdd ? (winding & 1) != 0 : winding != 0;
+	};
+
+	activeEdges.clear();
+	size_t iNext = 0;
+	for (int y = polygonEdges.front().yStart; y < yEndMax; y++)
+	{
+		// Retire the edges ending above this row, then bring in the ones starting on it
+		activeEdges.erase(std::remove_if(activeEdges.begin(), activeEdges.end(), [y](const PolygonEdge& e)
+		{
+			return e.yEnd <= y;
+		}), activeEdges.end());
+		if (activeEdges.empty() && iNext < polygonEdges.size())
+		{
+			y = std::max(y, polygonEdges[iNext].yStart);
+		}
+		while (iNext < polygonEdges.size() && polygonEdges[iNext].yStart == y)
+		{
+			activeEdges.push_back(polygonEdges[iNext++]);
+		}
+
+		// The order only changes where edges cross, insertion sort is close to linear
+		for (size_t i = 1; i < activeEdges.size(); i++)
+		{
+			const PolygonEdge e = activeEdges[i];
+			size_t j = i;
+			for (; j > 0 && activeEdges[j - 1].x > e.x; j--)
+			{
+				activeEdges[j] = activeEdges[j - 1];
+			}
+			activeEdges[j] = e;
+		}
+
+		// Spans between the crossings where the winding enters and leaves the inside
+		Color* const pRow = pTarget->GetRowPtr(y);
+		int winding = 0;
+		double spanStart = 0.0;
+		for (PolygonEdge& e : activeEdges)
+		{
+			const bool wasInside = IsInside(winding);
+			winding += e.winding;
+			if (!wasInside && IsInside(winding))
+			{
+				spanStart = e.x;
+			}
+			else if (wasInside && !IsInside(winding))
+			{
+				int xStart = (int)std::ceil(spanStart - 0.5);
+				int xEnd   = (int)std::ceil(e.x - 0.5);
+				if (clip)
+				{
+					xStart = std::max(xStart, 0);
+					xEnd   = std::min(xEnd, GetTargetWidth());
+				}
+				if (xStart < xEnd)
+				{
+					assert(xStart >= 0 && xEnd <= GetTargetWidth() && "Attempting to draw outside the surface");
+					span(pRow, y, xStart, xEnd);
+				}
+			}
+			e.x += e.dxdy;
+		}
+	}
+}
+
+void Rasterizer::DrawPolyline(const std::vector<Tesla::Vec2>& points, Color c)
+{
+	if (points.size() > 1)
+	{
+		for (auto i = points.cbegin(), end = std::prev(points.end()); i < end; i++)
+		{
+			DrawLine(*i, *std::next(i), c);
+		}
+	}
+}
+
+void Rasterizer::DrawPolyline(const std::vector<Tesla::Vec2>& points, Color c0, Color c1)
+{
+	if (points.size() > 1)
+	{
+		using namespace Tesla;
+
+		if (points.size() == 2)
+		{
+			DrawLine(points[0], points[1], c0, c1);
+		}
+		else
+		{
+			// The vertex colors in 16.16 fixed point, the step is truncated toward zero
+			// so the last vertex never gets past c1
+			const int channels0[3] = { c0.GetR(),c0.GetG(),c0.GetB() };
+			const int channels1[3] = { c1.GetR(),c1.GetG(),c1.GetB() };
+			const int nSteps = int(points.size() - 1);
+			int ch[3];
+			int dch[3];
+			for (int k = 0; k < 3; k++)
+			{
+				ch[k]  = channels0[k] << 16;
+				dch[k] = ((channels1[k] - channels0[k]) << 16) / nSteps;
+			}
+			auto col = [&ch]()
+			{
+				return Color(unsigned((ch[0] >> 16) << 16) | unsigned((ch[1] >> 16) << 8) | unsigned(ch[2] >> 16));
+			};
+
+			Color cur = c0;
+			for (auto i = points.cbegin(), end = std::prev(points.end()); i < end; i++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					ch[k] += dch[k];
+				}
+				const Color next = col();
+				DrawLine(*i, *std::next(i), cur, next);
+				cur = next;
+			}
+		}
+	}
+}
+
+void Rasterizer::DrawClosedPolyline(const std::vector<Tesla::Vec2>& points, Color c)
+{
+	if (points.size() > 1)
+	{
+		DrawPolyline(points, c);
+		DrawLine(*std::prev(points.end()), *points.begin(), c);
+	}
+}
+
+void Rasterizer::DrawPolylineAA(const std::vector<Tesla::Vec2>& points, Color c)
+{
+	if (points.size() > 1)
+	{
+		for (auto i = points.cbegin(), end = std::prev(points.end()); i < end; i++)
+		{
+			DrawLineAA(*i, *std::next(i), c);
+		}
+	}
+}
+
+void Rasterizer::DrawClosedPolylineAA(const std::vector<Tesla::Vec2>& points, Color c)
+{
+	if (points.size() > 1)
+	{
+		DrawPolylineAA(points, c);
+		DrawLineAA(*std::prev(points.end()), *points.begin(), c);
+	}
+}
+
+void Rasterizer::DrawCircle(float xc, float yc, float radius, Color c)
+{
+	DrawEllipse(xc, yc, radius, radius, c);
+}
+
+void Rasterizer::DrawCircle(const Tesla::Vec2& center, float radius, Color c)
+{
+	DrawCircle(center.x, center.y, radius, c);
+}
+
+void Rasterizer::FillCircle(float xc, float yc, float radius, Color c)
+{
+	FillEllipse(xc, yc, radius, radius, c);
+}
+
+void Rasterizer::FillCircle(const Tesla::Vec2& center, float radius, Color c)
+{
+	FillCircle(center.x, center.y, radius, c);
+}
+
+void Rasterizer::DrawEllipse(float xc, float yc, float ra, float rb, Color c)
+{
+	typedef long long ll;
+
+	// Pixel centers are on integer coordinates, as for DrawLine. The radii are
+	// limited so the decision variables below can't overflow 64 bits
+	const int cx = (int)std::floor(std::clamp(xc, -GuardBand, GuardBand) + 0.5f);
+	const int cy = (int)std::floor(std::clamp(yc, -GuardBand, GuardBand) + 0.5f);
+	const int a  = (int)std::floor(std::min(std::abs(ra), MaxEllipseRadius) + 0.5f);
+	const int b  = (int)std::floor(std::min(std::abs(rb), MaxEllipseRadius) + 0.5f);
+	if (b == 0)
+	{
+		DrawHLine(cx - a, cx + a, cy, c);
+		return;
+	}
+
+	const int width  = GetTargetWidth();
+	const int height = GetTargetHeight();
+	const bool inside = cx - a >= 0 && cx + a < width && cy - b >= 0 && cy + b < height;
+	if (clip)
+	{
+		if (cx + a < 0 || cx - a >= width || cy + b < 0 || cy - b >= height)
+		{
+			return;
+		}
+	}
+	else
+	{
+		assert(inside && "Attempting to draw outside the surface");
+	}
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		MarkDirty({ cx - a,cy - b,cx + a + 1,cy + b + 1 });
+	}
+
+	// Midpoint algorithm on the first quadrant, mirrored to the other three. Every step moves,
+	// and the mirrors skip the axes, so no pixel is written twice (that matters when blending)
+	Color* const pBuffer = pTarget->GetBufferPtr();
+	auto Walk = [&](auto Write, auto checked)
+	{
+		auto Plot = [&](int x, int y)
+		{
+			if (!decltype(checked)::value || (unsigned(x) < unsigned(width) && unsigned(y) < unsigned(height)))
+			{
+				Write(pBuffer[(size_t)width * y + x]);
+			}
+		};
+		auto Plot4 = [&](int x, int y)
+		{
+			Plot(cx + x, cy + y);
+			if (x != 0)
+			{
+				Plot(cx - x, cy + y);
+			}
+			if (y != 0)
+			{
+				Plot(cx + x, cy - y);
+				if (x != 0)
+				{
+					Plot(cx - x, cy - y);
+				}
+			}
+		};
+
+		// Decision variables are scaled by 4 to stay integer
+		const ll aSq = ll(a) * a;
+		const ll bSq = ll(b) * b;
+		int x = 0;
+		int y = b;
+		ll dx = 0;
+		ll dy = 2 * aSq * y;
+
+		// Region 1: the slope is above -1, x steps every time
+		ll d = 4 * bSq - 4 * aSq * b + aSq;
+		while (dx < dy)
+		{
+			Plot4(x, y);
+			x++;
+			dx += 2 * bSq;
+			if (d < 0)
+			{
+				d += 4 * (dx + bSq);
+			}
+			else
+			{
+				y--;
+				dy -= 2 * aSq;
+				d += 4 * (dx - dy + bSq);
+			}
+		}
+
+		// Region 2: y steps every time
+		d = bSq * (2 * x + 1) * (2 * x + 1) + 4 * aSq * (ll(y) - 1) * (ll(y) - 1) - 4 * aSq * bSq;
+		while (y >= 0)
+		{
+			Plot4(x, y);
+			y--;
+			dy -= 2 * aSq;
+			if (d > 0)
+			{
+				d += 4 * (aSq - dy);
+			}
+			else
+			{
+				x++;
+				dx += 2 * bSq;
+				d += 4 * (dx - dy + aSq);
+			}
+		}
+	};
+	auto Draw = [&](auto Write)
+	{
+		if (inside)
+		{
+			Walk(Write, std::false_type{});
+		}
+		else
+		{
+			Walk(Write, std::true_type{});
+		}
+	};
+	if (blendMode == Surface::BlendMode::Opaque)
+	{
+		Draw([c](Color& dst) { dst = c; });
+	}
+	else
+	{
+		Draw([c, mode = blendMode](Color& dst) { dst = Surface::Blend(dst, c, mode); });
+	}
+}
+
+void Rasterizer::DrawEllipse(const Tesla::Vec2& center, float ra, float rb, Color c)
+{
+	DrawEllipse(center.x, center.y, ra, rb, c);
+}
+
+void Rasterizer::FillEllipse(float xc, float yc, float ra, float rb, Color c)
+{
+	using namespace Tesla;
+	const int yStart = std::max((int)(yc - rb + 0.5f), 0);
+	const int yEnd   = std::min((int)(yc + rb + 0.5f), GetTargetHeight() - 1);
+	const float raSq = sq(ra);
+	const float rbSqInv = 1.0f / sq(rb);
+
+	for (int y = yStart; y <= yEnd; y++)
+	{
+		const float arg = 1.0f - rbSqInv * sq(static_cast<float>(y) - yc + 0.5f);
+		if (arg >= 0)
+		{
+			const float x_displacement = ra * std::sqrt(arg);
+
+			const int xStart = std::max(int(xc - x_displacement + 0.5f), 0);
+			const int xEnd   = std::min(int(xc + x_displacement + 0.5f), GetTargetWidth() - 1);
+
+			FillSpan(y, xStart, xEnd + 1, c);
+		}
+	}
+}
+
+void Rasterizer::FillEllipse(const Tesla::Vec2& center, float ra, float rb, Color c)
+{
+	FillEllipse(center.x, center.y, ra, rb, c);
+}
+
+// Half widths of the rows of the small circles, for every radius step k (radius k / steps): row dy
+// of the circle spans [-halfWidth, halfWidth] around the center pixel, for dy in [0, k / steps]
+struct CircleSpanTable
+{
+	std::vector<int> first;
+	std::vector<unsigned char> halfWidths;
+};
+
+static const CircleSpanTable& GetCircleSpanTable()
+{
+	static const CircleSpanTable table = []()
+	{
+		constexpr int steps = Rasterizer::CircleRadiusSteps;
+		CircleSpanTable t;
+		for (int k = 0; k < Rasterizer::SmallCircleRadius * steps; k++)
+		{
+			// Exact integer test: steps^2 * (dx^2 + dy^2) <= k^2
+			t.first.push_back((int)t.halfWidths.size());
+			for (int dy = 0; steps * dy <= k; dy++)
+			{
+				int hw = 0;
+				while (steps * steps * ((hw + 1) * (hw + 1) + dy * dy) <= k * k)
+				{
+					hw++;
+				}
+				t.halfWidths.push_back((unsigned char)hw);
+			}
+		}
+		return t;
+	}();
+	return table;
+}
+
+void Rasterizer::FillCircles(std::span<const Circle> circles)
+{
+	if (circles.empty())
+	{
+		return;
+	}
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		for (const Circle& circle : circles)
+		{
+			const float r = circle.radius + 1.0f;
+			MarkDirty({ int(std::floor(circle.center.x - r)),int(std::floor(circle.center.y - r)),int(std::ceil(circle.center.x + r)),int(std::ceil(circle.center.y + r)) });
+		}
+	}
+
+	if (!tiled)
+	{
+		for (const Circle& circle : circles)
+		{
+			FillCircleRows(circle, 0, GetTargetHeight() - 1);
+		}
+		return;
+	}
+
+	// Bands of TileSize rows: every band draws all its circles in order,
+	// and no pixel belongs to two bands, so the result is the serial one
+	const int nBands = (GetTargetHeight() + TileSize - 1) / TileSize;
+	pThreadPool->ParallelFor((unsigned int)nBands, [this, circles](unsigned int i)
+	{
+		const int yMin = int(i) * TileSize;
+		const int yMax = yMin + TileSize - 1;
+		for (const Circle& circle : circles)
+		{
+			if (circle.center.y + circle.radius + 1.0f >= float(yMin) && circle.center.y - circle.radius - 1.0f <= float(yMax + 1))
+			{
+				FillCircleRows(circle, yMin, yMax);
+			}
+		}
+	});
+}
+
+void Rasterizer::FillCircleRows(const Circle& circle, int yMin, int yMax) const
+{
+	const float radius = circle.radius;
+	if (!(radius >= 0.0f))
+	{
+		return;
+	}
+	yMin = std::max(yMin, 0);
+	yMax = std::min(yMax, GetTargetHeight() - 1);
+	const int width = GetTargetWidth();
+	auto Span = [&](int y, int xStart, int xEnd)
+	{
+		xStart = std::max(xStart, 0);
+		xEnd   = std::min(xEnd, width - 1);
+		if (xStart > xEnd)
+		{
+			return;
+		}
+		// Most particle rows are a handful of pixels, not worth the wide stores
+		Color* const pRow = pTarget->GetRowPtr(y);
+		if (blendMode == Surface::BlendMode::Opaque && xEnd - xStart < 16)
+		{
+			std::fill(pRow + xStart, pRow + xEnd + 1, circle.color);
+		}
+		else
+		{
+			Surface::BlendSpan(pRow, xStart, xEnd + 1, circle.color, blendMode);
+		}
+	};
+
+	const float xc = std::clamp(circle.center.x, -GuardBand, GuardBand);
+	const float yc = std::clamp(circle.center.y, -GuardBand, GuardBand);
+	if (radius < float(SmallCircleRadius) - 0.5f / CircleRadiusSteps)
+	{
+		const CircleSpanTable& table = GetCircleSpanTable();
+		const int k  = int(radius * CircleRadiusSteps + 0.5f);
+		const int cx = (int)std::floor(xc);
+		const int cy = (int)std::floor(yc);
+		const unsigned char* const pHalfWidths = &table.halfWidths[table.first[k]];
+		const int nRows = k / CircleRadiusSteps;
+		for (int y = std::max(cy - nRows, yMin); y <= std::min(cy + nRows, yMax); y++)
+		{
+			const int hw = pHalfWidths[std::abs(y - cy)];
+			Span(y, cx - hw, cx + hw);
+		}
+		return;
+	}
+
+	// Large circles: pixel (x, y) is in when its center (x + 0.5, y + 0.5) is
+	const int yStart = std::max((int)std::ceil(yc - radius - 0.5f), yMin);
+	const int yEnd   = std::min((int)std::floor(yc + radius - 0.5f), yMax);
+	const float rSq  = radius * radius;
+	for (int y = yStart; y <= yEnd; y++)
+	{
+		const float dy  = float(y) + 0.5f - yc;
+		const float arg = rSq - dy * dy;
+		if (arg >= 0.0f)
+		{
+			const float hw = std::sqrt(arg);
+			Span(y, (int)std::ceil(xc - hw - 0.5f), (int)std::floor(xc + hw - 0.5f));
+		}
+	}
+}
+
+void Rasterizer::DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c)
+{
+	DrawTriangle({ x0,y0 }, { x1,y1 }, { x1,x2 }, c);
+}
+
+void Rasterizer::DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c0, Color c1, Color c2)
+{
+	DrawLine(x0, y0, x1, y1, c0, c1);
+	DrawLine(x1, y1, x2, y2, c1, c2);
+	DrawLine(x2, y2, x0, y0, c2, c0);
+}
+
+void Rasterizer::DrawTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c)
+{
+	DrawLine(v0, v1, c);
+	DrawLine(v1, v2, c);
+	DrawLine(v2, v0, c);
+}
+
+void Rasterizer::DrawTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c0, Color c1, Color c2)
+{
+	DrawTriangle(v0.x, v0.y, v1.x, v1.y, v2.x, v2.y, c0, c1, c2);
+}
+
+void Rasterizer::FillTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c)
+{
+	Triangle tri;
+	if (SetupTriangle(v0, v1, v2, tri))
+	{
+		tri.type = Triangle::Type::Flat;
+		tri.c    = c;
+		SubmitTriangle(tri);
+	}
+}
+
+void Rasterizer::FillTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c)
+{
+	FillTriangle({ x0,y0 }, { x1,y1 }, { x2,y2 }, c);
+}
+
+void Rasterizer::FillTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c0, Color c1, Color c2)
+{
+	using namespace Tesla;
+
+	Triangle tri;
+	if (SetupTriangle(v0, v1, v2, tri))
+	{
+		// Color to Vec3 for easy interpolation
+		const Vec3 vc0 = { float(c0.GetR()),float(c0.GetG()),float(c0.GetB()) };
+		const Vec3 vc1 = { float(c1.GetR()),float(c1.GetG()),float(c1.GetB()) };
+		const Vec3 vc2 = { float(c2.GetR()),float(c2.GetG()),float(c2.GetB()) };
+
+		// The color at the AABB origin, 
+		// and the linear change amount per pixel step (horizontal and vertical)
+		const Vec3 col  = vc0 * tri.w0    + vc1 * tri.w1    + vc2 * tri.w2;
+		const Vec3 dcdx = vc0 * tri.dw0dx + vc1 * tri.dw1dx + vc2 * tri.dw2dx;
+		const Vec3 dcdy = vc0 * tri.dw0dy + vc1 * tri.dw1dy + vc2 * tri.dw2dy;
+
+		// In 16.16 fixed point. Each rounded step is off by half a unit at most, the start is
+		// raised by what the steps can lose across the AABB so no channel drops below 0
+		tri.type = Triangle::Type::Gradient;
+		auto ToFixed = [](float v)
+		{
+			return (unsigned int)std::llround(std::clamp(double(v), -1e12, 1e12) * 65536.0);
+		};
+		const unsigned int bias = unsigned(tri.xEnd - tri.xStart + tri.yEnd - tri.yStart) / 2u + 1u;
+		for (int k = 0; k < 3; k++)
+		{
+			tri.rgb[k]    = ToFixed((&col.x)[k]) + bias;
+			tri.drgbdx[k] = ToFixed((&dcdx.x)[k]);
+			tri.drgbdy[k] = ToFixed((&dcdy.x)[k]);
+		}
+		SubmitTriangle(tri);
+	}
+}
+
+void Rasterizer::FillTriangle(const Tesla::Vec2& v0, Color c0, const Tesla::Vec2& v1, Color c1, const Tesla::Vec2& v2, Color c2)
+{
+	FillTriangle(v0, v1, v2, c0, c1, c2);
+}
+
+void Rasterizer::FillTriangleTex(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, const Tesla::Vec2& uv0, const Tesla::Vec2& uv1, const Tesla::Vec2& uv2, const Surface& tex)
+{
+	Triangle tri;
+	if (SetupTriangle(v0, v1, v2, tri))
+	{
+		// The uv coords at the AABB origin, 
+		// and the linear change amount per pixel step (horizontal and vertical)
+		tri.type  = Triangle::Type::Textured;
+		tri.uv    = uv0 * tri.w0    + uv1 * tri.w1    + uv2 * tri.w2;
+		tri.duvdx = uv0 * tri.dw0dx + uv1 * tri.dw1dx + uv2 * tri.dw2dx;
+		tri.duvdy = uv0 * tri.dw0dy + uv1 * tri.dw1dy + uv2 * tri.dw2dy;
+		SetupTexture(tex, tri.duvdx, tri.duvdy, tri);
+
+		// Point sampled power of two levels step the texel coordinates in 16.16 fixed point.
+		// Clamp maps uv 0 and 1 to the first and last texels like Surface::Sample, Wrap and
+		// Mirror map a whole texture to 1.0. Clamping needs the true coordinates: it stays on the
+		// float path when they may not fit in 16.16 over the AABB
+		const Surface::MipLevel mip = tex.GetMip(tri.mipLevel);
+		auto IsPow2 = [](unsigned int n) { return (n & (n - 1u)) == 0u; };
+		if (tri.filter == Surface::Filter::Point && IsPow2(mip.width) && IsPow2(mip.height))
+		{
+			const bool clamp = textureAddressMode == Surface::AddressMode::Clamp;
+			const double w   = double(tri.xEnd - tri.xStart);
+			const double h   = double(tri.yEnd - tri.yStart);
+			auto ToFixed = [](double v)
+			{
+				return (unsigned int)std::llround(std::clamp(v, -1e12, 1e12) * 65536.0);
+			};
+			bool fits = true;
+			for (int k = 0; k < 2; k++)
+			{
+				const double size = double(k == 0 ? mip.width : mip.height) - (clamp ? 1.0 : 0.0);
+				const double t    = double((&tri.uv.x)[k]) * size;
+				const double dtdx = double((&tri.duvdx.x)[k]) * size;
+				const double dtdy = double((&tri.duvdy.x)[k]) * size;
+				fits = fits && std::abs(t) + std::abs(dtdx) * w + std::abs(dtdy) * h < 16384.0;
+				tri.texel[k]    = ToFixed(t);
+				tri.dtexeldx[k] = ToFixed(dtdx);
+				tri.dtexeldy[k] = ToFixed(dtdy);
+			}
+			if (fits || !clamp)
+			{
+				tri.type    = Triangle::Type::TexturedFixed;
+				tri.address = textureAddressMode;
+			}
+		}
+		SubmitTriangle(tri);
+	}
+}
+
+void Rasterizer::FillTriangleTex(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, const Tesla::Vec2& uv0, const Tesla::Vec2& uv1, const Tesla::Vec2& uv2, float invW0, float invW1, float invW2, const Surface& tex)
+{
+	using namespace Tesla;
+
+	assert(invW0 > 0.0f && invW1 > 0.0f && invW2 > 0.0f && "Vertices behind the eye must be clipped first");
+	Triangle tri;
+	if (SetupTriangle(v0, v1, v2, tri))
+	{
+		// u / w, v / w and 1 / w are linear in screen space
+		const Vec2 uvq0 = uv0 * invW0;
+		const Vec2 uvq1 = uv1 * invW1;
+		const Vec2 uvq2 = uv2 * invW2;
+		tri.type  = Triangle::Type::TexturedPerspective;
+		tri.uv    = uvq0 * tri.w0    + uvq1 * tri.w1    + uvq2 * tri.w2;
+		tri.duvdx = uvq0 * tri.dw0dx + uvq1 * tri.dw1dx + uvq2 * tri.dw2dx;
+		tri.duvdy = uvq0 * tri.dw0dy + uvq1 * tri.dw1dy + uvq2 * tri.dw2dy;
+		tri.q     = invW0 * tri.w0    + invW1 * tri.w1    + invW2 * tri.w2;
+		tri.dqdx  = invW0 * tri.dw0dx + invW1 * tri.dw1dx + invW2 * tri.dw2dx;
+		tri.dqdy  = invW0 * tri.dw0dy + invW1 * tri.dw1dy + invW2 * tri.dw2dy;
+		tri.qMin  = std::min({ invW0, invW1, invW2 });
+
+		// The mip level comes from the uv change per pixel at the centroid:
+		// d(u) = (d(u / w) - u * d(1 / w)) * w
+		const float q   = (invW0 + invW1 + invW2) / 3.0f;
+		const Vec2 uv   = (uvq0 + uvq1 + uvq2) / (3.0f * q);
+		const Vec2 duvdx = (tri.duvdx - uv * tri.dqdx) / q;
+		const Vec2 duvdy = (tri.duvdy - uv * tri.dqdy) / q;
+		SetupTexture(tex, duvdx, duvdy, tri);
+		SubmitTriangle(tri);
+	}
+}
+
+void Rasterizer::SetupTexture(const Surface& tex, const Tesla::Vec2& duvdx, const Tesla::Vec2& duvdy, Triangle& tri) const
+{
+	// Its log2 is the level of detail: the longest pixel step in texels of level 0
+	tri.pTex      = &tex;
+	tri.filter    = textureFilter;
+	tri.mipLevel  = 0u;
+	tri.mipWeight = 0u;
+	if (tex.GetMipCount() > 1u)
+	{
+		const float texelsX = float(tex.GetWidth()  - 1u);
+		const float texelsY = float(tex.GetHeight() - 1u);
+		auto TexelStepSq = [&](const Tesla::Vec2& duv)
+		{
+			return Tesla::Vec2(duv.x * texelsX, duv.y * texelsY).GetLengthSq();
+		};
+		const float lod    = 0.5f * std::log2(std::max({ TexelStepSq(duvdx), TexelStepSq(duvdy), 1.0f }));
+		const float maxLod = float(tex.GetMipCount() - 1u);
+		if (textureFilter == Surface::Filter::Trilinear)
+		{
+			const float clamped = std::min(lod, maxLod);
+			tri.mipLevel  = (unsigned int)clamped;
+			tri.mipWeight = (unsigned int)((clamped - float(tri.mipLevel)) * 256.0f);
+		}
+		else
+		{
+			tri.mipLevel = (unsigned int)std::min(lod + 0.5f, maxLod);
+		}
+	}
+	// Without a second level to blend, trilinear is bilinear
+	if (tri.filter == Surface::Filter::Trilinear && tri.mipWeight == 0u)
+	{
+		tri.filter = Surface::Filter::Bilinear;
+	}
+}
+
+bool Rasterizer::SetupTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Triangle& tri) const
+{
+	// Power
+	using namespace Tesla;
+	typedef long long ll;
+
+	// Vertices in 28.4 fixed point
+	auto Snap = [](float v) -> ll
+	{
+		return std::llround(std::clamp(v, -GuardBand, GuardBand) * float(1 << SubPixelBits));
+	};
+	const ll x0 = Snap(v0.x), y0 = Snap(v0.y);
+	ll x1 = Snap(v1.x), y1 = Snap(v1.y);
+	ll x2 = Snap(v2.x), y2 = Snap(v2.y);
+
+	// AABB - Aligned Axis Bounding Box, clipped (the shift floors negative coordinates too)
+	auto ToPixel = [](ll v, int maxPixel) -> int
+	{
+		return int(std::clamp(v >> SubPixelBits, ll(-1), ll(maxPixel) + 1));
+	};
+	tri.xStart = std::max(ToPixel(std::min({ x0,x1,x2 }), GetTargetWidth()), 0);
+	tri.yStart = std::max(ToPixel(std::min({ y0,y1,y2 }), GetTargetHeight()), 0);
+	tri.xEnd   = std::min(ToPixel(std::max({ x0,x1,x2 }), GetTargetWidth()), GetTargetWidth() - 1);
+	tri.yEnd   = std::min(ToPixel(std::max({ y0,y1,y2 }), GetTargetHeight()), GetTargetHeight() - 1);
+	tri.blend  = blendMode;
+
+	// Degenerate or offscreen triangles never cover a pixel
+	const ll area2 = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+	const float area = Vec2::Cross(v0 - v1, v2 - v1);
+	if (tri.xStart > tri.xEnd || tri.yStart > tri.yEnd || area2 == 0 || area == 0.0f)
+	{
+		return false;
+	}
+
+	// Make the winding positive so the inside of every edge is where its function is >= 0
+	if (area2 < 0)
+	{
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+	}
+
+	// Edge function of a -> b at the first pixel center, and its change for one pixel step.
+	// Pixels exactly on an edge belong to the triangle only if it is a top or a left edge
+	const ll px = (ll(tri.xStart) << SubPixelBits) + (1 << (SubPixelBits - 1));
+	const ll py = (ll(tri.yStart) << SubPixelBits) + (1 << (SubPixelBits - 1));
+	auto SetupEdge = [&](ll xa, ll ya, ll xb, ll yb, ll& e, ll& dedx, ll& dedy)
+	{
+		const ll dx = xb - xa;
+		const ll dy = yb - ya;
+		const bool topLeft = (dy < 0) || (dy == 0 && dx > 0);
+		e    = dx * (py - ya) - dy * (px - xa) - (topLeft ? 0 : 1);
+		dedx = -dy << SubPixelBits;
+		dedy =  dx << SubPixelBits;
+	};
+	SetupEdge(x1, y1, x2, y2, tri.e0, tri.de0dx, tri.de0dy);
+	SetupEdge(x2, y2, x0, y0, tri.e1, tri.de1dx, tri.de1dy);
+	SetupEdge(x0, y0, x1, y1, tri.e2, tri.de2dx, tri.de2dy);
+
+	// Normalized side vectors (also accounts for CW/CCW triangle vertices)
+	const float areaInv = 1.0f / area;
+	const Vec2 s01 = (v1 - v0) * areaInv;
+	const Vec2 s12 = (v2 - v1) * areaInv;
+	const Vec2 s20 = (v0 - v2) * areaInv;
+
+	// Starting point
+	const Vec2 p = { float(tri.xStart) + 0.5f,float(tri.yStart) + 0.5f };
+
+	// Barycentric coordinates at the AABB origin
+	tri.w0 = Vec2::Cross(p - v1, s12);
+	tri.w1 = Vec2::Cross(p - v2, s20);
+	tri.w2 = Vec2::Cross(p - v0, s01);
+
+	// Change of the barycentric coordinates for one pixel to the right and one pixel down
+	tri.dw0dx =  s12.y;
+	tri.dw1dx =  s20.y;
+	tri.dw2dx =  s01.y;
+	tri.dw0dy = -s12.x;
+	tri.dw1dy = -s20.x;
+	tri.dw2dy = -s01.x;
+	return true;
+}
+
+void Rasterizer::RasterizeTriangle(const Triangle& tri, int xMin, int yMin, int xMax, int yMax) const
+{
+	const int xStart = std::max(tri.xStart, xMin);
+	const int yStart = std::max(tri.yStart, yMin);
+	const int xEnd   = std::min(tri.xEnd, xMax);
+	const int yEnd   = std::min(tri.yEnd, yMax);
+	if (xStart > xEnd)
+	{
+		return;
+	}
+
+	RowKernel partialKernel = nullptr;
+	RowKernel coveredKernel = nullptr;
+	switch (tri.type)
+	{
+	case Triangle::Type::Flat:
+		partialKernel = partialKernels.flat;
+		coveredKernel = coveredKernels.flat;
+		break;
+	case Triangle::Type::Gradient:
+		partialKernel = partialKernels.gradient;
+		coveredKernel = coveredKernels.gradient;
+		break;
+	case Triangle::Type::Textured:
+		partialKernel = partialKernels.textured;
+		coveredKernel = coveredKernels.textured;
+		break;
+	case Triangle::Type::TexturedFixed:
+		partialKernel = partialKernels.fixedTextured[int(tri.address)];
+		coveredKernel = coveredKernels.fixedTextured[int(tri.address)];
+		break;
+	case Triangle::Type::TexturedPerspective:
+		partialKernel = partialKernels.perspective;
+		coveredKernel = coveredKernels.perspective;
+		break;
+	}
+
+	if (tri.blend != Surface::BlendMode::Opaque)
+	{
+		BlendTriangle(tri, coveredKernel, xStart, yStart, xEnd, yEnd);
+		return;
+	}
+
+	Color* const pBuffer = pTarget->GetBufferPtr();
+	const size_t pitch   = pTarget->GetWidth();
+
+	// Small triangles don't cover enough blocks to pay for the classification
+	if (xEnd - xStart < 2 * BlockSize && yEnd - yStart < 2 * BlockSize)
+	{
+		for (int y = yStart; y <= yEnd; y++)
+		{
+			partialKernel(tri, pBuffer + pitch * y, y, xStart, xEnd);
+		}
+		return;
+	}
+
+	// Block classification: the edge functions are exact and linear,
+	// so the corners of a block hold their minimum and maximum over it
+	enum class Coverage
+	{
+		Outside,
+		Partial,
+		Covered
+	};
+	auto Classify = [&tri](int x0, int y0, int x1, int y1) -> Coverage
+	{
+		bool covered = true;
+		auto TestEdge = [&](long long e, long long dedx, long long dedy) -> bool
+		{
+			const long long c0 = e + dedx * (x0 - tri.xStart) + dedy * (y0 - tri.yStart);
+			const long long c1 = c0 + dedx * (x1 - x0);
+			const long long c2 = c0 + dedy * (y1 - y0);
+			const long long c3 = c1 + dedy * (y1 - y0);
+			covered = covered && std::min({ c0, c1, c2, c3 }) >= 0;
+			return std::max({ c0, c1, c2, c3 }) >= 0;
+		};
+		if (!TestEdge(tri.e0, tri.de0dx, tri.de0dy) ||
+			!TestEdge(tri.e1, tri.de1dx, tri.de1dy) ||
+			!TestEdge(tri.e2, tri.de2dx, tri.de2dy))
+		{
+			return Coverage::Outside;
+		}
+		return covered ? Coverage::Covered : Coverage::Partial;
+	};
+
+	// Walk the screen aligned blocks band by band, merging neighbour blocks with the
+	// same coverage into runs so every row gets one kernel call per run
+	for (int by = yStart; by <= yEnd; by = (by / BlockSize + 1) * BlockSize)
+	{
+		const int byEnd = std::min((by / BlockSize + 1) * BlockSize - 1, yEnd);
+
+		int runStart = xStart;
+		Coverage runCoverage = Coverage::Outside;
+		auto EmitRun = [&](int runEnd)
+		{
+			if (runCoverage == Coverage::Outside)
+			{
+				return;
+			}
+			const RowKernel kernel = (runCoverage == Coverage::Covered) ? coveredKernel : partialKernel;
+			for (int y = by; y <= byEnd; y++)
+			{
+				kernel(tri, pBuffer + pitch * y, y, runStart, runEnd);
+			}
+		};
+
+		for (int bx = xStart; bx <= xEnd; bx = (bx / BlockSize + 1) * BlockSize)
+		{
+			const int bxEnd = std::min((bx / BlockSize + 1) * BlockSize - 1, xEnd);
+			const Coverage coverage = Classify(bx, by, bxEnd, byEnd);
+			if (coverage != runCoverage)
+			{
+				EmitRun(bx - 1);
+				runStart = bx;
+				runCoverage = coverage;
+			}
+		}
+		EmitRun(xEnd);
+	}
+}
+
+void Rasterizer::BlendTriangle(const Triangle& tri, RowKernel coveredKernel, int xStart, int yStart, int xEnd, int yEnd) const
+{
+	typedef long long ll;
+
+	Color* const pBuffer = pTarget->GetBufferPtr();
+	const size_t pitch   = pTarget->GetWidth();
+	Color scratch[BlendScratchSize];
+	for (int y = yStart; y <= yEnd; y++)
+	{
+		// A triangle covers one run of pixels per row: where all three
+		// edge functions are >= 0, solved exactly for each edge
+		ll lo = xStart;
+		ll hi = xEnd;
+		auto ClipEdge = [&](ll e, ll dedx, ll dedy)
+		{
+			const ll eRow = e + dedy * (y - tri.yStart) + dedx * (xStart - tri.xStart);
+			if (dedx > 0)
+			{
+				lo = std::max(lo, xStart + CeilDiv(-eRow, dedx));
+			}
+			else if (dedx < 0)
+			{
+				hi = std::min(hi, xStart + FloorDiv(eRow, -dedx));
+			}
+			else if (eRow < 0)
+			{
+				hi = lo - 1;
+			}
+		};
+		ClipEdge(tri.e0, tri.de0dx, tri.de0dy);
+		ClipEdge(tri.e1, tri.de1dx, tri.de1dy);
+		ClipEdge(tri.e2, tri.de2dx, tri.de2dy);
+		if (lo > hi)
+		{
+			continue;
+		}
+
+		Color* const pRow = pBuffer + pitch * y;
+		if (tri.type == Triangle::Type::Flat)
+		{
+			Surface::BlendSpan(pRow, (int)lo, (int)hi + 1, tri.c, tri.blend);
+			continue;
+		}
+		for (int x0 = (int)lo; x0 <= (int)hi; x0 += BlendScratchSize)
+		{
+			// The kernels address the row by absolute x, so hand them
+			// the scratch buffer shifted to start at x0
+			const int x1 = std::min((int)hi, x0 + BlendScratchSize - 1);
+			coveredKernel(tri, scratch - x0, y, x0, x1);
+			Surface::BlendSpan(pRow + x0, scratch, x1 - x0 + 1, tri.blend);
+		}
+	}
+}
+
+void Rasterizer::SubmitTriangle(const Triangle& tri)
+{
+	if (trackDirty)
+	{
+		MarkDirty({ tri.xStart,tri.yStart,tri.xEnd + 1,tri.yEnd + 1 });
+	}
+
+	if (!tiled)
+	{
+		RasterizeTriangle(tri, tri.xStart, tri.yStart, tri.xEnd, tri.yEnd);
+		return;
+	}
+
+	if (tileQueue.empty())
+	{
+		// The target cannot change while triangles are queued, so the grid is sized here
+		nTilesX = (GetTargetWidth()  + TileSize - 1) / TileSize;
+		nTilesY = (GetTargetHeight() + TileSize - 1) / TileSize;
+		tileBins.resize(size_t(nTilesX) * nTilesY);
+	}
+
+	const unsigned int index = (unsigned int)tileQueue.size();
+	tileQueue.push_back(tri);
+
+	// Bin the triangle in every tile its AABB touches, skipping the tiles that
+	// lie completely on the outer side of one of the edges
+	auto OutsideEdge = [&](long long e, long long dedx, long long dedy, int dx0, int dy0, int dx1, int dy1)
+	{
+		// Largest value of the edge function over the tile pixel centers
+		const long long eMax = e + std::max(dedx * dx0, dedx * dx1) + std::max(dedy * dy0, dedy * dy1);
+		return eMax < 0;
+	};
+
+	for (int ty = tri.yStart / TileSize; ty <= tri.yEnd / TileSize; ty++)
+	{
+		const int dy0 = std::max(ty * TileSize, tri.yStart) - tri.yStart;
+		const int dy1 = std::min(ty * TileSize + TileSize - 1, tri.yEnd) - tri.yStart;
+		for (int tx = tri.xStart / TileSize; tx <= tri.xEnd / TileSize; tx++)
+		{
+			const int dx0 = std::max(tx * TileSize, tri.xStart) - tri.xStart;
+			const int dx1 = std::min(tx * TileSize + TileSize - 1, tri.xEnd) - tri.xStart;
+			if (OutsideEdge(tri.e0, tri.de0dx, tri.de0dy, dx0, dy0, dx1, dy1) ||
+				OutsideEdge(tri.e1, tri.de1dx, tri.de1dy, dx0, dy0, dx1, dy1) ||
+				OutsideEdge(tri.e2, tri.de2dx, tri.de2dy, dx0, dy0, dx1, dy1))
+			{
+				continue;
+			}
+			tileBins[size_t(ty) * nTilesX + tx].push_back(index);
+		}
+	}
+}
+
+void Rasterizer::DrawSprite(int x, int y, const Surface& sprite)
+{
+	BlitSprite(x, y, { 0,0,(int)sprite.GetWidth(),(int)sprite.GetHeight() }, sprite, nullptr);
+}
+
+void Rasterizer::DrawSprite(int x, int y, const Surface& sprite, Color chroma)
+{
+	BlitSprite(x, y, { 0,0,(int)sprite.GetWidth(),(int)sprite.GetHeight() }, sprite, &chroma);
+}
+
+void Rasterizer::DrawSubSprite(int x, int y, const Surface::Rect& srcRect, const Surface& sprite)
+{
+	BlitSprite(x, y, srcRect, sprite, nullptr);
+}
+
+void Rasterizer::DrawSubSprite(int x, int y, const Surface::Rect& srcRect, const Surface& sprite, Color chroma)
+{
+	BlitSprite(x, y, srcRect, sprite, &chroma);
+}
+
+void Rasterizer::DrawSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface& sprite)
+{
+	BlitSpriteTransformed(center, scale, rotationRad, { 0,0,(int)sprite.GetWidth(),(int)sprite.GetHeight() }, sprite, nullptr);
+}
+
+void Rasterizer::DrawSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface& sprite, Color chroma)
+{
+	BlitSpriteTransformed(center, scale, rotationRad, { 0,0,(int)sprite.GetWidth(),(int)sprite.GetHeight() }, sprite, &chroma);
+}
+
+void Rasterizer::DrawSubSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface::Rect& srcRect, const Surface& sprite)
+{
+	BlitSpriteTransformed(center, scale, rotationRad, srcRect, sprite, nullptr);
+}
+
+void Rasterizer::DrawSubSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface::Rect& srcRect, const Surface& sprite, Color chroma)
+{
+	BlitSpriteTransformed(center, scale, rotationRad, srcRect, sprite, &chroma);
+}
+
+void Rasterizer::BlitSprite(int x, int y, const Surface::Rect& srcRect, const Surface& sprite, const Color* pChroma)
+{
+	assert(srcRect.left >= 0 && srcRect.top >= 0 && srcRect.right <= (int)sprite.GetWidth() && srcRect.bottom <= (int)sprite.GetHeight() && "Sprite rectangle outside the sprite");
+	int left   = srcRect.left;
+	int top    = srcRect.top;
+	int right  = srcRect.right;
+	int bottom = srcRect.bottom;
+	if (clip)
+	{
+		// Cut the source rectangle by as much as the destination sticks out of the target
+		left   += std::max(0, -x);
+		top    += std::max(0, -y);
+		x       = std::max(0, x);
+		y       = std::max(0, y);
+		right   = std::min(right , left + GetTargetWidth()  - x);
+		bottom  = std::min(bottom, top  + GetTargetHeight() - y);
+	}
+	if (left >= right || top >= bottom)
+	{
+		return;
+	}
+	const int width  = right - left;
+	const int height = bottom - top;
+	assert(x >= 0 && y >= 0 && x + width <= GetTargetWidth() && y + height <= GetTargetHeight() && "Attempting to draw outside the surface");
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		MarkDirty({ x,y,x + width,y + height });
+	}
+	// Whole rows at once: an opaque blit without color key is a plain copy
+	for (int row = 0; row < height; row++)
+	{
+		Color* const pDst       = pTarget->GetRowPtr(y + row) + x;
+		const Color* const pSrc = sprite.GetRowPtr(top + row) + left;
+		if (pChroma)
+		{
+			Surface::BlendSpan(pDst, pSrc, width, *pChroma, blendMode);
+		}
+		else
+		{
+			Surface::BlendSpan(pDst, pSrc, width, blendMode);
+		}
+	}
+}
+
+// Narrow the steps [kStart, kEnd) to the ones where 0 <= a + d * k < limit
+static void NarrowToRange(long long a, long long d, long long limit, int& kStart, int& kEnd) noexcept
+{
+	long long lo;
+	long long hi;
+	if (d != 0)
+	{
+		lo = (d > 0) ? CeilDiv(-a, d) : CeilDiv(limit - 1 - a, d);
+		hi = ((d > 0) ? FloorDiv(limit - 1 - a, d) : FloorDiv(-a, d)) + 1;
+	}
+	else
+	{
+		lo = a >= 0 && a < limit ? kStart : kEnd;
+		hi = kEnd;
+	}
+	kStart = (int)std::clamp<long long>(lo, kStart, kEnd);
+	kEnd   = (int)std::clamp<long long>(hi, kStart, kEnd);
+}
+
+void Rasterizer::BlitSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface::Rect& srcRect, const Surface& sprite, const Color* pChroma)
+{
+	assert(srcRect.left >= 0 && srcRect.top >= 0 && srcRect.right <= (int)sprite.GetWidth() && srcRect.bottom <= (int)sprite.GetHeight() && "Sprite rectangle outside the sprite");
+	assert(sprite.GetWidth() < 32768u && sprite.GetHeight() < 32768u && "Sprite too large for 16.16 texel coordinates");
+	assert(scale > 0.0f && "Bad sprite scale");
+	const int width  = srcRect.right - srcRect.left;
+	const int height = srcRect.bottom - srcRect.top;
+	if (width <= 0 || height <= 0)
+	{
+		return;
+	}
+
+	// AABB of the rotated and scaled sprite, clipped to the target
+	const double cosA = std::cos(double(rotationRad));
+	const double sinA = std::sin(double(rotationRad));
+	const double halfW = 0.5 * double(scale) * (std::abs(cosA) * width + std::abs(sinA) * height);
+	const double halfH = 0.5 * double(scale) * (std::abs(sinA) * width + std::abs(cosA) * height);
+	const int xStart = (int)std::clamp(std::floor(center.x - halfW), 0.0, (double)GetTargetWidth());
+	const int yStart = (int)std::clamp(std::floor(center.y - halfH), 0.0, (double)GetTargetHeight());
+	const int xEnd   = (int)std::clamp(std::ceil(center.x + halfW), 0.0, (double)GetTargetWidth());
+	const int yEnd   = (int)std::clamp(std::ceil(center.y + halfH), 0.0, (double)GetTargetHeight());
+	if (xStart >= xEnd || yStart >= yEnd)
+	{
+		return;
+	}
+	if (!tileQueue.empty())
+	{
+		Flush();
+	}
+	if (trackDirty)
+	{
+		MarkDirty({ xStart,yStart,xEnd,yEnd });
+	}
+
+	// Inverse mapping in 16.16: the offset of a pixel center from the sprite center, rotated
+	// back and divided by the scale, is the offset of its texel from the middle of srcRect.
+	// Per row, the pixels mapping inside srcRect are found exactly from these fixed point
+	// values, so the inner loop neither tests nor clamps
+	auto ToFixed = [](double v)
+	{
+		return std::llround(v * 65536.0);
+	};
+	const long long dudx = ToFixed(cosA / scale);
+	const long long dvdx = ToFixed(-sinA / scale);
+	const long long dudy = ToFixed(sinA / scale);
+	const long long dvdy = ToFixed(cosA / scale);
+	const double dx0 = xStart + 0.5 - center.x;
+	const double dy0 = yStart + 0.5 - center.y;
+	long long uRow = ToFixed((cosA * dx0 + sinA * dy0) / scale + 0.5 * width);
+	long long vRow = ToFixed((cosA * dy0 - sinA * dx0) / scale + 0.5 * height);
+	const long long uLimit = (long long)width << 16;
+	const long long vLimit = (long long)height << 16;
+
+	const Surface::MipLevel texels = sprite.GetMip(0);
+	const bool copy = blendMode == Surface::BlendMode::Opaque && !pChroma;
+	for (int y = yStart; y < yEnd; y++, uRow += dudy, vRow += dvdy)
+	{
+		int kStart = 0;
+		int kEnd   = xEnd - xStart;
+		NarrowToRange(uRow, dudx, uLimit, kStart, kEnd);
+		NarrowToRange(vRow, dvdx, vLimit, kStart, kEnd);
+		// Inside the span the coordinates are in [0, 2^31), 32 bit steps are enough
+		unsigned int u = (unsigned int)(uRow + dudx * kStart);
+		unsigned int v = (unsigned int)(vRow + dvdx * kStart);
+		auto Fetch = [&]()
+		{
+			const Color c = texels.pPixels[texels.RowOffset(srcRect.top + (v >> 16u)) + texels.ColumnOffset(srcRect.left + (u >> 16u))];
+			u += (unsigned int)dudx;
+			v += (unsigned int)dvdx;
+			return c;
+		};
+		Color* const pRow = pTarget->GetRowPtr(y) + xStart;
+		if (copy)
+		{
+			for (int k = kStart; k < kEnd; k++)
+			{
+				pRow[k] = Fetch();
+			}
+			continue;
+		}
+		// Blended or keyed: fetched into a scratch chunk, then blended as one span
+		Color scratch[BlendScratchSize];
+		for (int k0 = kStart; k0 < kEnd; k0 += BlendScratchSize)
+		{
+			const int count = std::min(kEnd - k0, BlendScratchSize);
+			for (int i = 0; i < count; i++)
+			{
+				scratch[i] = Fetch();
+			}
+			if (pChroma)
+			{
+				Surface::BlendSpan(pRow + k0, scratch, count, *pChroma, blendMode);
+			}
+			else
+			{
+				Surface::BlendSpan(pRow + k0, scratch, count, blendMode);
+			}
+		}
+	}
+}
+
+// Bezier curve of degree N - 1 given by its N control points
+template<size_t N>
+using BezierControls = std::array<Tesla::Vec2, N>;
+
+// Wang's formula: how many uniform steps keep the polyline within tolerance of the curve
+template<size_t N>
+static int BezierStepCount(const BezierControls<N>& p, float tolerance)
+{
+	static constexpr float degree = float(N - 1);
+	float maxSecondDiff = 0.0f;
+	for (size_t i = 0; i + 2 < N; i++)
+	{
+		maxSecondDiff = std::max(maxSecondDiff, (p[i + 2] - p[i + 1] * 2.0f + p[i]).GetLength());
+	}
+	const float n = std::ceil(std::sqrt(degree * (degree - 1.0f) / 8.0f * maxSecondDiff / tolerance));
+	return std::clamp(int(n), 1, Rasterizer::MaxBezierSteps);
+}
+
+// de Casteljau split at t = 0.5
+template<size_t N>
+static void SplitBezier(const BezierControls<N>& p, BezierControls<N>& left, BezierControls<N>& right)
+{
+	BezierControls<N> work = p;
+	for (size_t level = 0; level < N; level++)
+	{
+		left[level] = work[0];
+		right[N - 1 - level] = work[N - 1 - level];
+		for (size_t i = 0; i + 1 < N - level; i++)
+		{
+			work[i] = (work[i] + work[i + 1]) * 0.5f;
+		}
+	}
+}
+
+// Emit the points after p[0] of a uniform n step walk, by forward differencing
+template<size_t N, typename Emit>
+static void ForwardDifferenceBezier(const BezierControls<N>& p, int n, Emit emit)
+{
+	using namespace Tesla;
+	const float h = 1.0f / float(n);
+	Vec2 pos = p[0];
+	Vec2 d1, d2, d3;
+	if constexpr (N == 3)
+	{
+		// p(t) = a t^2 + b t + p0
+		const Vec2 a = p[0] - p[1] * 2.0f + p[2];
+		const Vec2 b = (p[1] - p[0]) * 2.0f;
+		d1 = a * (h * h) + b * h;
+		d2 = a * (2.0f * h * h);
+		d3 = Vec2(0.0f, 0.0f);
+	}
+	else
+	{
+		// p(t) = a t^3 + b t^2 + c t + p0
+		const Vec2 a = p[3] - p[2] * 3.0f + p[1] * 3.0f - p[0];
+		const Vec2 b = (p[0] - p[1] * 2.0f + p[2]) * 3.0f;
+		const Vec2 c = (p[1] - p[0]) * 3.0f;
+		d1 = a * (h * h * h) + b * (h * h) + c * h;
+		d2 = a * (6.0f * h * h * h) + b * (2.0f * h * h);
+		d3 = a * (6.0f * h * h * h);
+	}
+	for (int i = 1; i < n; i++)
+	{
+		pos += d1;
+		d1  += d2;
+		d2  += d3;
+		emit(pos);
+	}
+	// The sums drift, land exactly on the end point
+	emit(p[N - 1]);
+}
+
+// Split where the curvature is uneven: when the halves need clearly fewer steps together
+// than the whole, each gets its own step size. Uniform curves are walked in one go
+template<size_t N>
+static void FlattenBezier(const BezierControls<N>& p, float tolerance, std::vector<Tesla::Vec2>& points, int depth)
+{
+	static constexpr int maxDepth = 8;
+	static constexpr int minSplitSteps = 8;
+	const int n = BezierStepCount(p, tolerance);
+	if (depth < maxDepth && n > minSplitSteps)
+	{
+		BezierControls<N> left;
+		BezierControls<N> right;
+		SplitBezier(p, left, right);
+		if (4 * (BezierStepCount(left, tolerance) + BezierStepCount(right, tolerance)) < 3 * n)
+		{
+			FlattenBezier(left, tolerance, points, depth + 1);
+			FlattenBezier(right, tolerance, points, depth + 1);
+			return;
+		}
+	}
+	ForwardDifferenceBezier(p, n, [&points](const Tesla::Vec2& v) { points.push_back(v); });
+}
+
+template<size_t N>
+static void FlattenBezier(const BezierControls<N>& p, float tolerance, std::vector<Tesla::Vec2>& points)
+{
+	assert(tolerance > 0.0f && "Bezier flatness tolerance must be positive");
+	if (points.empty() || points.back().x != p[0].x || points.back().y != p[0].y)
+	{
+		points.push_back(p[0]);
+	}
+	FlattenBezier(p, tolerance, points, 0);
+}
+
+void Rasterizer::FlattenBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, std::vector<Tesla::Vec2>& points, float tolerance)
+{
+	FlattenBezier<3>({ p0,p1,p2 }, tolerance, points);
+}
+
+void Rasterizer::FlattenBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, std::vector<Tesla::Vec2>& points, float tolerance)
+{
+	FlattenBezier<4>({ p0,p1,p2,p3 }, tolerance, points);
+}
+
+void Rasterizer::DrawCurvePoints(Color c0, Color c1)
+{
+	// Colors follow the length along the polyline
+	using namespace Tesla;
+	float totalLength = 0.0f;
+	for (size_t i = 1; i < curvePoints.size(); i++)
+	{
+		totalLength += (curvePoints[i] - curvePoints[i - 1]).GetLength();
+	}
+	const Vec3 vc0 = { (float)c0.GetR(),(float)c0.GetG(),(float)c0.GetB() };
+	const Vec3 vc1 = { (float)c1.GetR(),(float)c1.GetG(),(float)c1.GetB() };
+	auto ColorAt = [&](float length)
+	{
+		const Vec3 vc = vc0 + (vc1 - vc0) * (totalLength > 0.0f ? length / totalLength : 0.0f);
+		return Color((unsigned char)vc.x, (unsigned char)vc.y, (unsigned char)vc.z);
+	};
+
+	float length = 0.0f;
+	Color cur = c0;
+	for (size_t i = 1; i < curvePoints.size(); i++)
+	{
+		length += (curvePoints[i] - curvePoints[i - 1]).GetLength();
+		const Color next = ColorAt(length);
+		DrawLine(curvePoints[i - 1], curvePoints[i], cur, next);
+		cur = next;
+	}
+}
+
+void Rasterizer::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, Color c)
+{
+	// QUADRATIC VERSION
+	// 
+	// Barozzi rules. Period.
+	// 1 = ((1 - t) + t)^2 =
+	// 1 = (1 - t)^2 + 2(1 - t) t + t^2
+	// 1 = b0(t) + b1(t) + b2(t)
+	// b0(t), b1(t), b2(t) sono i polinomi di Bernstein
+	// Una parametrizzazione della curva di Bezier  data da
+	// p(t) = b0(t) * p0 + b1(t) * p1 + b2(t) * p2
+	// 
+	// The polynomial is walked by forward differencing, with as many steps as the
+	// flatness tolerance asks for (FlattenBezierCurve)
+	curvePoints.clear();
+	FlattenBezierCurve(p0, p1, p2, curvePoints);
+	DrawPolyline(curvePoints, c);
+}
+
+void Rasterizer::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, Color c0, Color c2)
+{
+	// QUADRATIC VERSION, COLOR INTERPOLATION
+	curvePoints.clear();
+	FlattenBezierCurve(p0, p1, p2, curvePoints);
+	DrawCurvePoints(c0, c2);
+}
+
+void Rasterizer::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, Color c)
+{
+	// CUBIC VERSION
+	//
+	// Barozzi rules. Period.
+	// 1 = ((1 - t) + t)^3 =
+	// 1 = (1 - t)^3 + 3(1 - t)^2 t + 3(1 - t) t^2 + t^3
+	// 1 = b0(t) + b1(t) + b2(t) + b3(t)
+	// b0(t), b1(t), b2(t), b3(t) sono i polinomi di Bernstein
+	// Una parametrizzazione della curva di Bezier  data da
+	// p(t) = b0(t) * p0 + b1(t) * p1 + b2(t) * p2 + b3(t) * p3;
+	curvePoints.clear();
+	FlattenBezierCurve(p0, p1, p2, p3, curvePoints);
+	DrawPolyline(curvePoints, c);
+}
+
+void Rasterizer::DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, Color c0, Color c3)
+{
+	// CUBIC VERSION, COLOR INTERPOLATION
+	curvePoints.clear();
+	FlattenBezierCurve(p0, p1, p2, p3, curvePoints);
+	DrawCurvePoints(c0, c3);
+}
+
+void Rasterizer::DrawSPLine(std::span<const Tesla::Vec2> points, Color c)
+{
+	// Catmull-Rom spline passing through every point, the end points are repeated to
+	// make the first and last segments. Each segment is the cubic Bezier
+	// p1, p1 + (p2 - p0) / 6, p2 - (p3 - p1) / 6, p2
+	// walked in as many steps as the flatness tolerance asks for. The lines are streamed
+	// to DrawLines in batches, the control points are read in place
+	using namespace Tesla;
+
+	const size_t nPoints = points.size();
+	if (nPoints < 2u)
+	{
+		return;
+	}
+
+	// Segments whose control polygon is out of the target are skipped. The margin
+	// covers the rounding of the line endpoints to pixel centers
+	const float xMax = float(GetTargetWidth()) + 1.0f;
+	const float yMax = float(GetTargetHeight()) + 1.0f;
+	auto IsVisible = [&](const BezierControls<4>& b)
+	{
+		if (!clip)
+		{
+			return true;
+		}
+		const float left   = std::min(std::min(b[0].x, b[1].x), std::min(b[2].x, b[3].x));
+		const float right  = std::max(std::max(b[0].x, b[1].x), std::max(b[2].x, b[3].x));
+		const float top    = std::min(std::min(b[0].y, b[1].y), std::min(b[2].y, b[3].y));
+		const float bottom = std::max(std::max(b[0].y, b[1].y), std::max(b[2].y, b[3].y));
+		return right >= -1.0f && left <= xMax && bottom >= -1.0f && top <= yMax;
+	};
+
+	std::array<LineSegment, LineBatchSize> batch;
+	size_t count = 0;
+	Vec2 cur;
+	auto Emit = [&](const Vec2& next)
+	{
+		batch[count++] = { cur,next };
+		cur = next;
+		if (count == batch.size())
+		{
+			DrawLines(batch, c);
+			count = 0;
+		}
+	};
+
+	for (size_t i = 0; i + 1 < nPoints; i++)
+	{
+		const Vec2& p0 = points[i > 0 ? i - 1 : 0];
+		const Vec2& p1 = points[i];
+		const Vec2& p2 = points[i + 1];
+		const Vec2& p3 = points[std::min(i + 2, nPoints - 1)];
+		const BezierControls<4> b = { p1, p1 + (p2 - p0) * (1.0f / 6.0f), p2 - (p3 - p1) * (1.0f / 6.0f), p2 };
+		if (IsVisible(b))
+		{
+			cur = p1;
+			ForwardDifferenceBezier(b, BezierStepCount(b, BezierFlatness), Emit);
+		}
+	}
+	DrawLines(std::span<const LineSegment>(batch.data(), count), c);
+}
@@ -0,0 +1,447 @@
+#pragma once
+#include "Tesla.h"
+#include "Surface.h"
+#include "TeslaThreadPool.h"
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+// Software rasterizer: draws every primitive into a render target Surface.
+// It knows nothing about windows or D3D11, so it can run headless as well
+class Rasterizer
+{
+public:
+	Rasterizer(Surface& renderTarget) noexcept;
+	Rasterizer(const Rasterizer&) = delete;
+	Rasterizer& operator = (const Rasterizer&) = delete;
+	~Rasterizer() = default;
+public:
+	static constexpr int TileSize = 64;
+public:
+	// Redirect all the drawing to another Surface
+	void SetRenderTarget(Surface& renderTarget);
+	Surface& GetRenderTarget() const noexcept;
+	int GetTargetWidth() const noexcept;
+	int GetTargetHeight() const noexcept;
+	void Clear(Color fillColor) noexcept;
+	// Partial clears, the triangles queued before them are resolved first
+	void ClearRect(const Surface::Rect& rect, Color fillColor);
+	void ClearRegions(std::span<const Surface::Rect> rects, Color fillColor);
+	void EnableClipping() noexcept;
+	void DisableClipping() noexcept;
+	bool IsClippingEnabled() const noexcept;
+	// How the primitives drawn from now on combine with the target (Surface::BlendMode).
+	// It applies to pixels, solid lines, rectangles, ellipses and filled triangles, which
+	// blend with the X byte their shading produces (gradients have none). Gradient and
+	// anti-aliased lines always write their own colors. Default is Opaque
+	void SetBlendMode(Surface::BlendMode mode) noexcept;
+	Surface::BlendMode GetBlendMode() const noexcept;
+	// How FillTriangleTex samples its texture (Surface::Filter). When the texture has a mip
+	// chain the level is picked per triangle from the uv change per pixel. Default is Point
+	void SetTextureFilter(Surface::Filter filter) noexcept;
+	Surface::Filter GetTextureFilter() const noexcept;
+	// Point sampled power of two textures (or mip levels) step their texel coordinates in 16.16
+	// fixed point and address them with bit masks. There the address mode picks what lies
+	// outside the texture (Surface::AddressMode): Wrap and Mirror repeat it every 1.0 of uv.
+	// Any other texture is clamped. Default is Clamp
+	void SetTextureAddressMode(Surface::AddressMode mode) noexcept;
+	Surface::AddressMode GetTextureAddressMode() const noexcept;
+	// In tiled mode the filled triangles are binned into TileSize x TileSize screen tiles
+	// and rasterized in parallel on Flush(). Any other primitive, a render target change
+	// or the end of the frame flushes first, so the drawing order is preserved.
+	// Textures passed to FillTriangleTex must stay alive until the flush
+	void EnableTiledRasterization(unsigned int nThreads = std::thread::hardware_concurrency());
+	void DisableTiledRasterization();
+	bool IsTiledRasterizationEnabled() const noexcept;
+	void Flush();
+	// Dirty tracking: every primitive marks the DirtyCellSize x DirtyCellSize cells it touches
+	// in the frame target (the render target the Rasterizer was built with). GetDirtyRegions()
+	// merges the cells changed since the frame began into rectangles, which is all a backend
+	// has to transfer. Writes that bypass the Rasterizer must be reported with MarkDirty()
+	static constexpr int DirtyCellSize = 32;
+	void MarkDirty(const Surface::Rect& rect) noexcept;
+	const std::vector<Surface::Rect>& GetDirtyRegions();
+	size_t GetDirtyByteCount();
+public:
+	/************************************ POINT ******************************************/
+	void PutPixel(int x, int y, Color c);
+	void PutPixel(const Tesla::Vec2& p, Color c);
+	void PutPixel(const Tesla::Vei2& p, Color c);
+	void PutPixel(int x, int y, unsigned char r, unsigned char g, unsigned char b);
+
+	/************************************* SPAN ******************************************/
+	// Direct row access for code writing runs of pixels: both resolve the queued triangles
+	// first. GetRowPtr marks the whole row as dirty, FillSpan fills (and marks) only the
+	// half-open span [xStart, xEnd) of row y (clipped if enabled)
+	Color* GetRowPtr(int y);
+	void FillSpan(int y, int xStart, int xEnd, Color c);
+
+	/************************************* LINE ******************************************/
+	void DrawHLine(int xStart, int xEnd, int y, Color c);
+	void DrawVLine(int yStart, int yEnd, int x, Color c);
+	void DrawHLine(float xStart, float xEnd, float y, Color c);
+	void DrawVLine(float yStart, float yEnd, float x, Color c);
+	void DrawLine(int x0, int y0, int x1, int y1, Color c);
+	void DrawLine(float x0, float y0, float x1, float y1, Color c);
+	void DrawLine(int x0, int y0, int x1, int y1, Color c0, Color c1);
+	void DrawLine(float x0, float y0, float x1, float y1, Color c0, Color c1);
+	void DrawLine(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c);
+	void DrawLine(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c0, Color c1);
+	// Draw many segments in one call (one color for all of them or one per segment).
+	// Segments fully inside or fully outside the target skip the clipping setup
+	struct LineSegment
+	{
+		Tesla::Vec2 p0;
+		Tesla::Vec2 p1;
+	};
+	void DrawLines(std::span<const LineSegment> segments, Color c);
+	void DrawLines(std::span<const LineSegment> segments, std::span<const Color> colors);
+	// Anti-aliased (Wu) lines: the two pixels straddling the line at each step are blended
+	// with the color by their coverage, which is passed to the blend in the X byte
+	void DrawLineAA(float x0, float y0, float x1, float y1, Color c);
+	void DrawLineAA(const Tesla::Vec2& p0, const Tesla::Vec2& p1, Color c);
+
+	/*********************************** RECTANGLE ***************************************/
+	void DrawRect(int left, int right, int top, int bottom, Color c);
+	void DrawRect(float left, float right, float top, float bottom, Color c);
+	void DrawRect(const Tesla::Vei2& topLeft, int width, int height, Color c);
+	void DrawRect(const Tesla::Vec2& topLeft, float width, float height, Color c);
+	void DrawRectDim(int topLeftX, int topLeftY, int width, int height, Color c);
+	void DrawRectDim(float topLeftX, float topLeftY, float width, float height, Color c);
+	void DrawRectDim(const Tesla::Vei2& topLeft, int width, int height, Color c);
+	void DrawRectDim(const Tesla::Vec2& topLeft, float width, float height, Color c);
+	void FillRect(int left, int right, int top, int bottom, Color c);
+	void FillRect(float left, float right, float top, float bottom, Color c);
+	void FillRect(const Tesla::Vei2& topLeft, int width, int height, Color c);
+	void FillRect(const Tesla::Vec2& topLeft, float width, float height, Color c);
+	void FillRectDim(int topLeftX, int topLeftY, int width, int height, Color c);
+	void FillRectDim(float topLeftX, float topLeftY, float width, float height, Color c);
+	void FillRectDim(const Tesla::Vei2& topLeft, int width, int height, Color c);
+	void FillRectDim(const Tesla::Vec2& topLeft, float width, float height, Color c);
+
+	/****************************** REGULAR POLYGONS *************************************/
+	// The vertices come from a unit ring cached per side count, scaled and rotated by one
+	// matrix. Fills are a single scanline pass over the polygon (FillPolygon)
+	void DrawRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c);
+	void DrawRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c);
+	void FillRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c);
+	void FillRegularPolygon(float x, float y, int nSides, float radius, float rotationRad, Color c_int, Color c_ext, bool rainbowMode = false);
+	void FillRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c);
+	void FillRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad, Color c_int, Color c_ext, bool rainbowMode = false);
+
+	/************************************* POLYGONS **************************************/
+	// Fill any polygon (concave, self-intersecting) in a single top to bottom scanline pass over
+	// an edge table and a list of the edges crossing the current row. Pixel (x, y) is in when its
+	// center (x + 0.5, y + 0.5) is inside by the fill rule: every pixel is written once, and
+	// polygons sharing an edge don't overlap. The last vertex connects back to the first
+	enum class FillRule
+	{
+		EvenOdd,	// Inside when a ray from it crosses the outline an odd number of times
+		NonZero		// Inside when the outline winds around it
+	};
+	void FillPolygon(std::span<const Tesla::Vec2> vertices, Color c, FillRule rule = FillRule::NonZero);
+
+	/*********************************** POLYLINES ***************************************/
+	void DrawPolyline(const std::vector<Tesla::Vec2>& points, Color c);
+	void DrawPolyline(const std::vector<Tesla::Vec2>& points, Color cStart, Color cEnd);
+	void DrawClosedPolyline(const std::vector<Tesla::Vec2>& points, Color c);
+	void DrawPolylineAA(const std::vector<Tesla::Vec2>& points, Color c);
+	void DrawClosedPolylineAA(const std::vector<Tesla::Vec2>& points, Color c);
+
+	/******************************* CONIC SECTIONS **************************************/
+	// Ellipse and circle outlines are walked pixel by pixel (midpoint algorithm), so their
+	// cost follows the perimeter. Radii are clamped to MaxEllipseRadius
+	static constexpr float MaxEllipseRadius = 16384.0f;
+	void DrawCircle(float xc, float yc, float radius, Color c);
+	void DrawCircle(const Tesla::Vec2& center, float radius, Color c);
+	void DrawEllipse(float xc, float yc, float ra, float rb, Color c);
+	void DrawEllipse(const Tesla::Vec2& center, float ra, float rb, Color c);
+	void FillCircle(float xc, float yc, float radius, Color c);
+	void FillCircle(const Tesla::Vec2& center, float radius, Color c);
+	void FillEllipse(float xc, float yc, float ra, float rb, Color c);
+	void FillEllipse(const Tesla::Vec2& center, float ra, float rb, Color c);
+	// Draw many filled circles in one call (particles). A pixel is covered when its center is
+	// inside the circle. Circles under SmallCircleRadius have their center snapped to a pixel
+	// center and their radius to 1 / CircleRadiusSteps, and take their spans from precomputed
+	// tables. In tiled mode the rows are split in bands drawn in parallel, in circle order
+	struct Circle
+	{
+		Tesla::Vec2 center;
+		float radius;
+		Color color;
+	};
+	static constexpr int SmallCircleRadius = 32;
+	static constexpr int CircleRadiusSteps = 4;
+	void FillCircles(std::span<const Circle> circles);
+
+	/********************************** TRIANGLES ****************************************/
+	void DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c);
+	void DrawTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c0, Color c1, Color c2);
+	void DrawTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c);
+	void DrawTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c0, Color c1, Color c2);
+	void FillTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c);
+	void FillTriangle(float x0, float y0, float x1, float y1, float x2, float y2, Color c);
+	void FillTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Color c0, Color c1, Color c2);
+	void FillTriangle(const Tesla::Vec2& v0, Color c0, const Tesla::Vec2& v1, Color c1, const Tesla::Vec2& v2, Color c2);
+	void FillTriangleTex(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, const Tesla::Vec2& uv0, const Tesla::Vec2& uv1, const Tesla::Vec2& uv2, const Surface& tex);
+	// Perspective-correct variant for projected meshes: invW0..2 are the 1 / w of the vertices
+	// after the projection, and must be > 0 (clip against the near plane first). u / w, v / w
+	// and 1 / w are interpolated, the exact uv is computed every PerspectiveSpan pixels (from
+	// the AABB left side) and interpolated linearly in between
+	static constexpr int PerspectiveSpan = 16;
+	void FillTriangleTex(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, const Tesla::Vec2& uv0, const Tesla::Vec2& uv1, const Tesla::Vec2& uv2, float invW0, float invW1, float invW2, const Surface& tex);
+
+	/************************************ SPRITES ****************************************/
+	// Draw a Surface, or the srcRect part of it, with its top left corner at (x, y). It is clipped
+	// once (if enabled) and copied row by row, or blended with the blend mode. The color key
+	// variants skip the source pixels whose RGB equals chroma (the X bytes are ignored)
+	void DrawSprite(int x, int y, const Surface& sprite);
+	void DrawSprite(int x, int y, const Surface& sprite, Color chroma);
+	void DrawSubSprite(int x, int y, const Surface::Rect& srcRect, const Surface& sprite);
+	void DrawSubSprite(int x, int y, const Surface::Rect& srcRect, const Surface& sprite, Color chroma);
+	// Scaled and rotated around its center, which lands on center. Every target pixel whose
+	// center maps inside the sprite takes the nearest texel, the inverse mapping is stepped in
+	// 16.16 fixed point. Always clipped to the target, sprites in any Surface::Layout are fine
+	void DrawSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface& sprite);
+	void DrawSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface& sprite, Color chroma);
+	void DrawSubSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface::Rect& srcRect, const Surface& sprite);
+	void DrawSubSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface::Rect& srcRect, const Surface& sprite, Color chroma);
+
+	/********************* BEZIER AND SMOOTH INTERPOLATION *******************************/
+	// Flatten a quadratic or cubic Bezier curve into a polyline within tolerance pixels of it.
+	// The points are appended to the buffer, the first one only if it isn't already its last
+	// point, so consecutive curves chain into one path. The step count follows the curvature
+	static constexpr float BezierFlatness = 0.25f;
+	static constexpr int MaxBezierSteps   = 4096;
+	static void FlattenBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, std::vector<Tesla::Vec2>& points, float tolerance = BezierFlatness);
+	static void FlattenBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, std::vector<Tesla::Vec2>& points, float tolerance = BezierFlatness);
+	void DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, Color c);
+	void DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, Color c0, Color c2);
+	void DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, Color c);
+	void DrawBezierCurve(const Tesla::Vec2& p0, const Tesla::Vec2& p1, const Tesla::Vec2& p2, const Tesla::Vec2& p3, Color c0, Color c3);
+	// Catmull-Rom spline through the points, walked in place without allocating
+	void DrawSPLine(std::span<const Tesla::Vec2> points, Color c);
+private:
+	// A line ready to be drawn: the DDA steps one pixel along the major axis and carries the
+	// minor coordinate in 32.32 fixed point. The steps [iStart, iEnd] are the ones inside the
+	// target, (x, y) is the pixel of step iStart. Endpoints are clamped to the guard band
+	struct Line
+	{
+		int iStart;
+		int iEnd;
+		int x;
+		int y;
+		bool xMajor;
+		int majorDir;
+		long long minor;
+		long long dminor;
+		float length;
+	};
+	bool SetupLine(float x0, float y0, float x1, float y1, bool clipLine, Line& line) const;
+	// Resolve the tile queue and mark the part of the target a line will write
+	void PrepareLine(const Line& line);
+	// Blend src over dst using the X byte of src as alpha
+	static Color AlphaBlend(Color dst, Color src) noexcept;
+	// Sprite blits behind the public overloads, pChroma is the color key or nullptr
+	void BlitSprite(int x, int y, const Surface::Rect& srcRect, const Surface& sprite, const Color* pChroma);
+	void BlitSpriteTransformed(const Tesla::Vec2& center, float scale, float rotationRad, const Surface::Rect& srcRect, const Surface& sprite, const Color* pChroma);
+	// A polygon edge crossing the rows [yStart, yEnd), x is where it crosses the center of the
+	// current row (double: hundreds of float steps drift enough to flip pixels on the edge)
+	// and winding is +1 going down, -1 going up
+	struct PolygonEdge
+	{
+		int yStart;
+		int yEnd;
+		double x;
+		double dxdy;
+		int winding;
+	};
+	// Scan convert a polygon, calling span(pRow, y, xStart, xEnd) on the half-open spans inside
+	template<typename SpanFunc>
+	void ScanPolygon(std::span<const Tesla::Vec2> vertices, FillRule rule, SpanFunc span);
+	// The nSides vertices of the unit circle starting at angle 0 and their rainbow colors,
+	// computed on first use
+	struct PolygonRing
+	{
+		std::vector<Tesla::Vec2> unit;
+		std::vector<Tesla::Vec3> rainbow;
+	};
+	const PolygonRing& GetPolygonRing(int nSides);
+	// Color gradient of a wedge of the regular polygon fan, and dx / dy along its first ray
+	struct PolygonWedge
+	{
+		Tesla::Vec3 dcdx;
+		Tesla::Vec3 dcdy;
+		float raySlope;
+	};
+	// Put the vertices of a regular polygon in polygonVertices
+	void BuildRegularPolygon(const Tesla::Vec2& center, int nSides, float radius, float rotationRad);
+	// Stroke curvePoints with colors interpolated along its length
+	void DrawCurvePoints(Color c0, Color c1);
+	// Draw the rows of a circle between yMin and yMax (clipped to the target)
+	void FillCircleRows(const Circle& circle, int yMin, int yMax) const;
+	void RasterizeLine(const Line& line, Color c);
+	void RasterizeLine(const Line& line, Color c0, Color c1);
+	template<typename ColorOf>
+	void DrawLineBatch(std::span<const LineSegment> segments, ColorOf colorOf);
+private:
+	// Line batches are classified against the target in structure-of-arrays form: Inside
+	// segments need no clipping, Rejected ones can't touch the target (RasterizerKernels.cpp)
+	enum class LineClass : unsigned char
+	{
+		Rejected,
+		Clipped,
+		Inside
+	};
+	static constexpr int LineBatchSize = 256;
+	struct LineBatch
+	{
+		alignas(32) float x0[LineBatchSize];
+		alignas(32) float y0[LineBatchSize];
+		alignas(32) float x1[LineBatchSize];
+		alignas(32) float y1[LineBatchSize];
+		LineClass cls[LineBatchSize];
+	};
+	typedef void (*LineClassifier)(LineBatch& batch, int count, float width, float height);
+	static LineClassifier GetLineClassifier() noexcept;
+	static void ClassifyLines(LineBatch& batch, int count, float width, float height);
+	static void ClassifyLinesSSE2(LineBatch& batch, int count, float width, float height);
+	static void ClassifyLinesAVX2(LineBatch& batch, int count, float width, float height);
+private:
+	// A filled triangle ready to be rasterized: clipped AABB, integer edge functions and float
+	// barycentric coordinates at the AABB origin, and their change for one pixel step right (dx)
+	// and down (dy). The edge functions decide the coverage, the barycentrics only interpolate
+	struct Triangle
+	{
+		enum class Type
+		{
+			Flat,
+			Gradient,
+			Textured,
+			TexturedFixed,
+			TexturedPerspective
+		};
+		Type type;
+		int xStart;
+		int yStart;
+		int xEnd;
+		int yEnd;
+		long long e0, de0dx, de0dy;
+		long long e1, de1dx, de1dy;
+		long long e2, de2dx, de2dy;
+		float w0, dw0dx, dw0dy;
+		float w1, dw1dx, dw1dy;
+		float w2, dw2dx, dw2dy;
+		Color c;
+		Surface::BlendMode blend;
+		// Gradient R, G and B in 16.16 fixed point at the AABB origin, and their change for one
+		// pixel step. The sums may wrap around away from the covered pixels
+		unsigned int rgb[3], drgbdx[3], drgbdy[3];
+		unsigned int GradientAt(int k, int x, int y) const noexcept
+		{
+			return rgb[k] + drgbdx[k] * unsigned(x - xStart) + drgbdy[k] * unsigned(y - yStart);
+		}
+		// For TexturedPerspective uv holds u / w and v / w, q is 1 / w and qMin its smallest value
+		// over the triangle: the exact divides at the ends of the spans never go below it
+		Tesla::Vec2 uv, duvdx, duvdy;
+		float q, dqdx, dqdy, qMin;
+		const Surface* pTex;
+		// Filter, mip level and, for Trilinear, the weight of the next level in 1/256
+		Surface::Filter filter;
+		unsigned int mipLevel;
+		unsigned int mipWeight;
+		// TexturedFixed: texel x and y in 16.16 fixed point at the AABB origin, and their change
+		// for one pixel step. The sums wrap around modulo 2^32, a multiple of every texture size
+		unsigned int texel[2], dtexeldx[2], dtexeldy[2];
+		unsigned int TexelAt(int k, int x, int y) const noexcept
+		{
+			return texel[k] + dtexeldx[k] * unsigned(x - xStart) + dtexeldy[k] * unsigned(y - yStart);
+		}
+		Surface::AddressMode address;
+	};
+	// Vertices are snapped to 28.4 fixed point (1/16 pixel) for the edge functions. A top-left
+	// fill rule makes triangles sharing an edge cover each of its pixels exactly once.
+	// Coordinates are clamped to the guard band so the 64 bit edge functions can't overflow
+	static constexpr int SubPixelBits = 4;
+	static constexpr float GuardBand  = 1048576.0f;
+	bool SetupTriangle(const Tesla::Vec2& v0, const Tesla::Vec2& v1, const Tesla::Vec2& v2, Triangle& tri) const;
+	// Texture, filter and mip level of a textured triangle, from the uv change per pixel
+	void SetupTexture(const Surface& tex, const Tesla::Vec2& duvdx, const Tesla::Vec2& duvdy, Triangle& tri) const;
+	void SubmitTriangle(const Triangle& tri);
+	// Rasterize the part of the triangle inside the [xMin, xMax] x [yMin, yMax] rectangle
+	void RasterizeTriangle(const Triangle& tri, int xMin, int yMin, int xMax, int yMax) const;
+private:
+	// Row kernels write the covered pixels of row y between xStart and xEnd (RasterizerKernels.cpp).
+	// The SSE2/AVX2 ones are picked once by CPU detection and give the same result as the scalar ones.
+	// The covered variants skip the edge tests, they are only called on spans fully inside the triangle
+	typedef void (*RowKernel)(const Triangle& tri, Color* pRow, int y, int xStart, int xEnd);
+	struct RowKernels
+	{
+		RowKernel flat;
+		RowKernel gradient;
+		RowKernel textured;
+		RowKernel perspective;
+		// By Surface::AddressMode
+		RowKernel fixedTextured[3];
+	};
+	static const RowKernels& GetRowKernels(bool covered) noexcept;
+	// Blended triangles go row by row: the covered span is shaded into BlendScratchSize
+	// pixel chunks by the covered kernel and blended into the target from there
+	static constexpr int BlendScratchSize = 256;
+	void BlendTriangle(const Triangle& tri, RowKernel coveredKernel, int xStart, int yStart, int xEnd, int yEnd) const;
+	template<Triangle::Type type, bool covered, Surface::AddressMode address = Surface::AddressMode::Clamp>
+	static void RasterizeRow(const Triangle& tri, Color* pRow, int y, int xStart, int xEnd);
+	template<Triangle::Type type, bool covered, Surface::AddressMode address = Surface::AddressMode::Clamp>
+	static void RasterizeRowSSE2(const Triangle& tri, Color* pRow, int y, int xStart, int xEnd);
+	template<Triangle::Type type, bool covered, Surface::AddressMode address = Surface::AddressMode::Clamp>
+	static void RasterizeRowAVX2(const Triangle& tri, Color* pRow, int y, int xStart, int xEnd);
+	// Triangles are classified by BlockSize x BlockSize screen blocks: blocks outside one
+	// of the edges are skipped, blocks inside all of them are filled without edge tests
+	static constexpr int BlockSize = 8;
+protected:
+	// Start a new frame in the frame target. When clearing with the same color as the last
+	// clear, only the cells drawn since then are cleared: the rest is still that color
+	void BeginDirtyFrame(bool clear, Color clearColor);
+private:
+	enum DirtyFlags : unsigned char
+	{
+		Changed = 1u,	// Must be transferred at the end of this frame
+		Drawn   = 2u	// May hold something else than the last clear color
+	};
+	void MarkDirty(int x, int y) noexcept;
+	void BuildDirtyRegions(unsigned char flags);
+protected:
+	bool clip = true;
+	Surface* pTarget;
+private:
+	const RowKernels& partialKernels;
+	const RowKernels& coveredKernels;
+	Surface::BlendMode blendMode = Surface::BlendMode::Opaque;
+	Surface::Filter textureFilter = Surface::Filter::Point;
+	Surface::AddressMode textureAddressMode = Surface::AddressMode::Clamp;
+	// Scratch buffer of the curves, kept to avoid an allocation per curve
+	std::vector<Tesla::Vec2> curvePoints;
+	// Edge table and active edges of FillPolygon, kept for the same reason
+	std::vector<PolygonEdge> polygonEdges;
+	std::vector<PolygonEdge> activeEdges;
+	// Regular polygon vertices and wedge gradients, and the unit rings by side count
+	std::vector<Tesla::Vec2> polygonVertices;
+	std::vector<PolygonWedge> polygonWedges;
+	std::unordered_map<int, PolygonRing> polygonRings;
+	bool tiled = false;
+	std::unique_ptr<TeslaThreadPool> pThreadPool;
+	std::vector<Triangle> tileQueue;
+	std::vector<std::vector<unsigned int>> tileBins;
+	int nTilesX = 0;
+	int nTilesY = 0;
+private:
+	Surface* const pFrameTarget;
+	bool trackDirty = false;
+	std::vector<unsigned char> dirtyCells;
+	int nDirtyCellsX = 0;
+	int nDirtyCellsY = 0;
+	std::vector<Surface::Rect> dirtyRegions;
+	bool lastClearValid = false;
+	Color lastClearColor;
+};
@@ -0,0 +1,882 @@
+#include "Rasterizer.h"
+#include "TeslaCPU.h"
+#ifdef TESLA_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Coverage comes from the exact integer edge functions. The attributes of a pixel are evaluated as
+// row value + step * (x - xStart of the AABB), with the very same float operations in every lane.
+// Gradient colors are 16.16 integers stepped from the AABB origin (exact in any order) and saturated
+// to bytes. So scalar, SSE2 and AVX2 produce bit-identical framebuffers, however rows are split
+
+/*************************************************************************************/
+/************************************* SCALAR ****************************************/
+// Texel along an axis of a power of two level, from its integer coordinate
+template<Surface::AddressMode address>
+static unsigned int AddressTexel(int i, unsigned int size) noexcept
+{
+	if constexpr (address == Surface::AddressMode::Clamp)
+	{
+		return unsigned(std::clamp(i, 0, int(size) - 1));
+	}
+	else if constexpr (address == Surface::AddressMode::Wrap)
+	{
+		return unsigned(i) & (size - 1u);
+	}
+	else
+	{
+		// Every other copy of the texture is flipped
+		const unsigned int t = unsigned(i) & (2u * size - 1u);
+		return (t & (size - 1u)) ^ ((t & size) != 0u ? size - 1u : 0u);
+	}
+}
+
+template<Rasterizer::Triangle::Type type, bool covered, Surface::AddressMode address>
+void Rasterizer::RasterizeRow(const Triangle& tri, Color* pRow, int y, int xStart, int xEnd)
+{
+	using namespace Tesla;
+
+	// A covered flat span is a plain fill
+	if constexpr (covered && type == Triangle::Type::Flat)
+	{
+		Surface::FillSpan(pRow, xStart, xEnd + 1, tri.c);
+		return;
+	}
+
+	const float fy = float(y - tri.yStart);
+
+	// Edge functions at the first pixel of the span, attributes at the start of the row
+	long long e0 = tri.e0 + tri.de0dy * (y - tri.yStart) + tri.de0dx * (xStart - tri.xStart);
+	long long e1 = tri.e1 + tri.de1dy * (y - tri.yStart) + tri.de1dx * (xStart - tri.xStart);
+	long long e2 = tri.e2 + tri.de2dy * (y - tri.yStart) + tri.de2dx * (xStart - tri.xStart);
+	const Vec2 uv_row = tri.uv + tri.duvdy * fy;
+	const float q_row = type == Triangle::Type::TexturedPerspective ? tri.q + tri.dqdy * fy : 0.0f;
+
+	// Fixed point attributes stepped along the row: gradient R, G and B, or texel x and y
+	unsigned int fixed[3]  = {};
+	unsigned int dfixed[3] = {};
+	if constexpr (type == Triangle::Type::Gradient)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			fixed[k]  = tri.GradientAt(k, xStart, y);
+			dfixed[k] = tri.drgbdx[k];
+		}
+	}
+	else if constexpr (type == Triangle::Type::TexturedFixed)
+	{
+		for (int k = 0; k < 2; k++)
+		{
+			fixed[k]  = tri.TexelAt(k, xStart, y);
+			dfixed[k] = tri.dtexeldx[k];
+		}
+	}
+	const Surface::MipLevel mip = type == Triangle::Type::TexturedFixed ? tri.pTex->GetMip(tri.mipLevel) : Surface::MipLevel{};
+
+	// Perspective: the exact uv at a column offset from the AABB origin, and at both ends of the
+	// PerspectiveSpan pixels long span holding the current pixel
+	auto PerspectiveUV = [&](float fa)
+	{
+		const float w = 1.0f / std::max(q_row + tri.dqdx * fa, tri.qMin);
+		return Vec2((uv_row.x + tri.duvdx.x * fa) * w, (uv_row.y + tri.duvdx.y * fa) * w);
+	};
+	int spanStart = -1;
+	Vec2 uvStart = { 0.0f,0.0f };
+	Vec2 uvEnd   = { 0.0f,0.0f };
+
+	// x-loop
+	for (int x = xStart; x <= xEnd; x++, e0 += tri.de0dx, e1 += tri.de1dx, e2 += tri.de2dx, fixed[0] += dfixed[0], fixed[1] += dfixed[1], fixed[2] += dfixed[2])
+	{
+		const float fx = float(x - tri.xStart);
+
+		// Only draw pixels inside all three edges (no sign bit set in any of them)
+		if (covered || (e0 | e1 | e2) >= 0)
+		{
+			if constexpr (type == Triangle::Type::Flat)
+			{
+				pRow[x] = tri.c;
+			}
+			else if constexpr (type == Triangle::Type::Gradient)
+			{
+				// Saturated like the packs of the SIMD kernels
+				auto Channel = [](unsigned int v)
+				{
+					return v < 0x01000000u ? v >> 16u : (int(v) < 0 ? 0u : 0xFFu);
+				};
+				pRow[x] = Color((Channel(fixed[0]) << 16u) | (Channel(fixed[1]) << 8u) | Channel(fixed[2]));
+			}
+			else if constexpr (type == Triangle::Type::TexturedFixed)
+			{
+				const unsigned int tx = AddressTexel<address>(int(fixed[0]) >> 16, mip.width);
+				const unsigned int ty = AddressTexel<address>(int(fixed[1]) >> 16, mip.height);
+				pRow[x] = mip.pPixels[mip.RowOffset(ty) + mip.ColumnOffset(tx)];
+			}
+			else
+			{
+				Vec2 uv;
+				if constexpr (type == Triangle::Type::Textured)
+				{
+					uv = uv_row + tri.duvdx * fx;
+				}
+				else
+				{
+					const int offset = x - tri.xStart;
+					const int k = offset & (PerspectiveSpan - 1);
+					if (offset - k != spanStart)
+					{
+						spanStart = offset - k;
+						uvStart   = PerspectiveUV(float(spanStart));
+						uvEnd     = PerspectiveUV(float(spanStart + PerspectiveSpan));
+					}
+					uv = uvStart + (uvEnd - uvStart) * (float(k) * (1.0f / float(PerspectiveSpan)));
+				}
+				switch (tri.filter)
+				{
+				case Surface::Filter::Point:
+					pRow[x] = tri.pTex->Sample(uv.x, uv.y, tri.mipLevel);
+					break;
+				case Surface::Filter::Bilinear:
+					pRow[x] = tri.pTex->SampleBilinear(uv.x, uv.y, tri.mipLevel);
+					break;
+				case Surface::Filter::Trilinear:
+					pRow[x] = tri.pTex->SampleTrilinear(uv.x, uv.y, tri.mipLevel, tri.mipWeight);
+					break;
+				}
+			}
+		}
+	}
+}
+
+#ifdef TESLA_SIMD_X86
+/*************************************************************************************/
+/********************************* TEXTURE SAMPLING **********************************/
+// The SIMD samplers repeat the float operations of Surface::Sample and Surface::SampleBilinear
+// lane by lane, and their lerps widen the bytes to 16 bit lanes for the integer math of
+// Surface::Lerp: a * (256 - w) + b * w is computed as (a << 8) + (b - a) * w, which is the same
+// value modulo 2^16 and fits in 16 bits
+
+// Per byte lerp of 4 pixels, w holds the weight of every pixel in [0, 256]
+TESLA_TARGET_SSE2 static __m128i Lerp4SSE2(__m128i a, __m128i b, __m128i w) noexcept
+{
+	const __m128i zero = _mm_setzero_si128();
+	// The weight of pixels 0-1 and 2-3 in the 16 bit lanes of their 4 bytes
+	const __m128i w2 = _mm_or_si128(w, _mm_slli_epi32(w, 16));
+	auto Half = [&](__m128i a16, __m128i b16, __m128i w16) TESLA_TARGET_SSE2
+	{
+		return _mm_srli_epi16(_mm_add_epi16(_mm_slli_epi16(a16, 8), _mm_mullo_epi16(_mm_sub_epi16(b16, a16), w16)), 8);
+	};
+	return _mm_packus_epi16(
+		Half(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi32(w2, w2)),
+		Half(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi32(w2, w2)));
+}
+
+TESLA_TARGET_SSE2 static __m128i SamplePoint4SSE2(const Surface::MipLevel& mip, __m128 u, __m128 v) noexcept
+{
+	// No gather in SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 uMax = _mm_set1_ps(float(mip.width  - 1u));
+	const __m128 vMax = _mm_set1_ps(float(mip.height - 1u));
+	alignas(16) int tx[4];
+	alignas(16) int ty[4];
+	_mm_store_si128((__m128i*)tx, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(u, uMax), zero), uMax)));
+	_mm_store_si128((__m128i*)ty, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(v, vMax), zero), vMax)));
+	auto Texel = [&](int i) TESLA_TARGET_SSE2
+	{
+		return (int)mip.pPixels[mip.RowOffset(ty[i]) + mip.ColumnOffset(tx[i])].dword;
+	};
+	return _mm_setr_epi32(Texel(0), Texel(1), Texel(2), Texel(3));
+}
+
+TESLA_TARGET_SSE2 static __m128i SampleBilinear4SSE2(const Surface::MipLevel& mip, __m128 u, __m128 v) noexcept
+{
+	const __m128 zero  = _mm_setzero_ps();
+	const __m128 scale = _mm_set1_ps(256.0f);
+	const __m128 xMax  = _mm_set1_ps(float(mip.width  - 1u));
+	const __m128 yMax  = _mm_set1_ps(float(mip.height - 1u));
+	const __m128 x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(u, xMax), zero), xMax);
+	const __m128 y = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, yMax), zero), yMax);
+	const __m128i x0 = _mm_cvttps_epi32(x);
+	const __m128i y0 = _mm_cvttps_epi32(y);
+	const __m128i fx = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(x0)), scale));
+	const __m128i fy = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(y0)), scale));
+	// The next column and row, but the last ones (the compare masks are -1)
+	const __m128i x1 = _mm_sub_epi32(x0, _mm_cmplt_epi32(x0, _mm_set1_epi32(int(mip.width  - 1u))));
+	const __m128i y1 = _mm_sub_epi32(y0, _mm_cmplt_epi32(y0, _mm_set1_epi32(int(mip.height - 1u))));
+	alignas(16) int tx[2][4];
+	alignas(16) int ty[2][4];
+	_mm_store_si128((__m128i*)tx[0], x0);
+	_mm_store_si128((__m128i*)tx[1], x1);
+	_mm_store_si128((__m128i*)ty[0], y0);
+	_mm_store_si128((__m128i*)ty[1], y1);
+	// Texel offsets of the 2 columns and the 2 rows of every lane
+	size_t columns[2][4];
+	size_t rows[2][4];
+	for (int i = 0; i < 4; i++)
+	{
+		columns[0][i] = mip.ColumnOffset(tx[0][i]);
+		columns[1][i] = mip.ColumnOffset(tx[1][i]);
+		rows[0][i]    = mip.RowOffset(ty[0][i]);
+		rows[1][i]    = mip.RowOffset(ty[1][i]);
+	}
+	const Color* const pTex = mip.pPixels;
+	auto Gather = [&](const size_t* pColumns, const size_t* pRows) TESLA_TARGET_SSE2
+	{
+		return _mm_setr_epi32(
+			(int)pTex[pRows[0] + pColumns[0]].dword,
+			(int)pTex[pRows[1] + pColumns[1]].dword,
+			(int)pTex[pRows[2] + pColumns[2]].dword,
+			(int)pTex[pRows[3] + pColumns[3]].dword);
+	};
+	const __m128i top    = Lerp4SSE2(Gather(columns[0], rows[0]), Gather(columns[1], rows[0]), fx);
+	const __m128i bottom = Lerp4SSE2(Gather(columns[0], rows[1]), Gather(columns[1], rows[1]), fx);
+	return Lerp4SSE2(top, bottom, fy);
+}
+
+// Texels along an axis of a power of two level from the integer coordinates of 4 lanes, as AddressTexel
+template<Surface::AddressMode address>
+TESLA_TARGET_SSE2 static __m128i AddressTexels4SSE2(__m128i i, unsigned int size) noexcept
+{
+	const __m128i last = _mm_set1_epi32(int(size - 1u));
+	if constexpr (address == Surface::AddressMode::Clamp)
+	{
+		// No 32 bit min and max in SSE2: zero the negative lanes, then take last above it
+		i = _mm_andnot_si128(_mm_srai_epi32(i, 31), i);
+		const __m128i above = _mm_cmpgt_epi32(i, last);
+		return _mm_or_si128(_mm_andnot_si128(above, i), _mm_and_si128(above, last));
+	}
+	else if constexpr (address == Surface::AddressMode::Wrap)
+	{
+		return _mm_and_si128(i, last);
+	}
+	else
+	{
+		const __m128i t    = _mm_and_si128(i, _mm_set1_epi32(int(2u * size - 1u)));
+		const __m128i flip = _mm_cmpeq_epi32(_mm_and_si128(t, _mm_set1_epi32(int(size))), _mm_set1_epi32(int(size)));
+		return _mm_xor_si128(_mm_and_si128(t, last), _mm_and_si128(flip, last));
+	}
+}
+
+TESLA_TARGET_AVX2 static __m256i Lerp8AVX2(__m256i a, __m256i b, __m256i w) noexcept
+{
+	// Same as SSE2, the unpacks and the pack work in each 128 bit half
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i w2 = _mm256_or_si256(w, _mm256_slli_epi32(w, 16));
+	auto Half = [&](__m256i a16, __m256i b16, __m256i w16) TESLA_TARGET_AVX2
+	{
+		return _mm256_srli_epi16(_mm256_add_epi16(_mm256_slli_epi16(a16, 8), _mm256_mullo_epi16(_mm256_sub_epi16(b16, a16), w16)), 8);
+	};
+	return _mm256_packus_epi16(
+		Half(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi32(w2, w2)),
+		Half(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi32(w2, w2)));
+}
+
+// Texel offsets of 8 lanes, as Surface::MipLevel::RowOffset and ColumnOffset
+TESLA_TARGET_AVX2 static __m256i RowOffset8AVX2(const Surface::MipLevel& mip, __m256i y) noexcept
+{
+	const __m256i pitch = _mm256_set1_epi32((int)mip.pitch);
+	if (mip.layout == Surface::Layout::Tiled)
+	{
+		return _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(y, 2), pitch), _mm256_slli_epi32(_mm256_and_si256(y, _mm256_set1_epi32(3)), 2));
+	}
+	return _mm256_mullo_epi32(y, pitch);
+}
+
+TESLA_TARGET_AVX2 static __m256i ColumnOffset8AVX2(const Surface::MipLevel& mip, __m256i x) noexcept
+{
+	if (mip.layout == Surface::Layout::Tiled)
+	{
+		return _mm256_add_epi32(_mm256_slli_epi32(_mm256_srli_epi32(x, 2), 4), _mm256_and_si256(x, _mm256_set1_epi32(3)));
+	}
+	return x;
+}
+
+template<Surface::AddressMode address>
+TESLA_TARGET_AVX2 static __m256i AddressTexels8AVX2(__m256i i, unsigned int size) noexcept
+{
+	const __m256i last = _mm256_set1_epi32(int(size - 1u));
+	if constexpr (address == Surface::AddressMode::Clamp)
+	{
+		return _mm256_min_epi32(_mm256_max_epi32(i, _mm256_setzero_si256()), last);
+	}
+	else if constexpr (address == Surface::AddressMode::Wrap)
+	{
+		return _mm256_and_si256(i, last);
+	}
+	else
+	{
+		const __m256i t    = _mm256_and_si256(i, _mm256_set1_epi32(int(2u * size - 1u)));
+		const __m256i flip = _mm256_cmpeq_epi32(_mm256_and_si256(t, _mm256_set1_epi32(int(size))), _mm256_set1_epi32(int(size)));
+		return _mm256_xor_si256(_mm256_and_si256(t, last), _mm256_and_si256(flip, last));
+	}
+}
+
+TESLA_TARGET_AVX2 static __m256i SamplePoint8AVX2(const Surface::MipLevel& mip, __m256 u, __m256 v) noexcept
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 uMax = _mm256_set1_ps(float(mip.width  - 1u));
+	const __m256 vMax = _mm256_set1_ps(float(mip.height - 1u));
+	const __m256i tx = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(u, uMax), zero), uMax));
+	const __m256i ty = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, vMax), zero), vMax));
+	const __m256i index = _mm256_add_epi32(RowOffset8AVX2(mip, ty), ColumnOffset8AVX2(mip, tx));
+	return _mm256_i32gather_epi32((const int*)mip.pPixels, index, 4);
+}
+
+TESLA_TARGET_AVX2 static __m256i SampleBilinear8AVX2(const Surface::MipLevel& mip, __m256 u, __m256 v) noexcept
+{
+	const __m256 zero  = _mm256_setzero_ps();
+	const __m256 scale = _mm256_set1_ps(256.0f);
+	const __m256 xMax  = _mm256_set1_ps(float(mip.width  - 1u));
+	const __m256 yMax  = _mm256_set1_ps(float(mip.height - 1u));
+	const __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(u, xMax), zero), xMax);
+	const __m256 y = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, yMax), zero), yMax);
+	const __m256i x0 = _mm256_cvttps_epi32(x);
+	const __m256i y0 = _mm256_cvttps_epi32(y);
+	const __m256i fx = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(x, _mm256_cvtepi32_ps(x0)), scale));
+	const __m256i fy = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(y, _mm256_cvtepi32_ps(y0)), scale));
+	// The next column and row, but the last ones (the compare masks are -1)
+	const __m256i x1 = _mm256_sub_epi32(x0, _mm256_cmpgt_epi32(_mm256_set1_epi32(int(mip.width  - 1u)), x0));
+	const __m256i y1 = _mm256_sub_epi32(y0, _mm256_cmpgt_epi32(_mm256_set1_epi32(int(mip.height - 1u)), y0));
+	const __m256i row0 = RowOffset8AVX2(mip, y0);
+	const __m256i row1 = RowOffset8AVX2(mip, y1);
+	const __m256i col0 = ColumnOffset8AVX2(mip, x0);
+	const __m256i col1 = ColumnOffset8AVX2(mip, x1);
+	const int* const pTex = (const int*)mip.pPixels;
+	const __m256i top = Lerp8AVX2(
+		_mm256_i32gather_epi32(pTex, _mm256_add_epi32(row0, col0), 4),
+		_mm256_i32gather_epi32(pTex, _mm256_add_epi32(row0, col1), 4), fx);
+	const __m256i bottom = Lerp8AVX2(
+		_mm256_i32gather_epi32(pTex, _mm256_add_epi32(row1, col0), 4),
+		_mm256_i32gather_epi32(pTex, _mm256_add_epi32(row1, col1), 4), fx);
+	return Lerp8AVX2(top, bottom, fy);
+}
+
+/*************************************************************************************/
+/************************************** SSE2 *****************************************/
+template<Rasterizer::Triangle::Type type, bool covered, Surface::AddressMode address>
+TESLA_TARGET_SSE2 void Rasterizer::RasterizeRowSSE2(const Triangle& tri, Color* pRow, int y, int xStart, int xEnd)
+{
+	if constexpr (covered && type == Triangle::Type::Flat)
+	{
+		Surface::FillSpan(pRow, xStart, xEnd + 1, tri.c);
+		return;
+	}
+
+	const float fy = float(y - tri.yStart);
+
+	// Texture levels of the sampling, and the weight of the second one
+	Surface::MipLevel mips[2] = {};
+	__m128i mipWeight = _mm_setzero_si128();
+	if constexpr (type == Triangle::Type::Textured || type == Triangle::Type::TexturedFixed || type == Triangle::Type::TexturedPerspective)
+	{
+		mips[0] = tri.pTex->GetMip(tri.mipLevel);
+		if (tri.filter == Surface::Filter::Trilinear)
+		{
+			mips[1]   = tri.pTex->GetMip(tri.mipLevel + 1u);
+			mipWeight = _mm_set1_epi32(int(tri.mipWeight));
+		}
+	}
+
+	// Fixed point attributes of the 4 lanes in 16.16 (gradient R, G and B, or texel x and y),
+	// stepped 4 pixels at a time
+	constexpr int nFixed = type == Triangle::Type::Gradient ? 3 : type == Triangle::Type::TexturedFixed ? 2 : 0;
+	__m128i fixed[3];
+	__m128i dfixed[3];
+	for (int k = 0; k < nFixed; k++)
+	{
+		const unsigned int c = type == Triangle::Type::Gradient ? tri.GradientAt(k, xStart, y) : tri.TexelAt(k, xStart, y);
+		const unsigned int d = type == Triangle::Type::Gradient ? tri.drgbdx[k] : tri.dtexeldx[k];
+		fixed[k]  = _mm_setr_epi32(int(c), int(c + d), int(c + 2u * d), int(c + 3u * d));
+		dfixed[k] = _mm_set1_epi32(int(4u * d));
+	}
+
+	// Edge functions of the 4 lanes as two pairs of 64 bit values (lanes 0-1 and 2-3)
+	struct Edge
+	{
+		__m128i lo;
+		__m128i hi;
+		__m128i step;
+	};
+	auto SetupEdge = [&](long long e, long long dedx, long long dedy) TESLA_TARGET_SSE2 -> Edge
+	{
+		e += dedy * (y - tri.yStart) + dedx * (xStart - tri.xStart);
+		return { _mm_set_epi64x(e + dedx, e), _mm_set_epi64x(e + 3 * dedx, e + 2 * dedx), _mm_set1_epi64x(4 * dedx) };
+	};
+	Edge edges[3] = {
+		SetupEdge(tri.e0, tri.de0dx, tri.de0dy),
+		SetupEdge(tri.e1, tri.de1dx, tri.de1dy),
+		SetupEdge(tri.e2, tri.de2dx, tri.de2dy)
+	};
+	auto Step = [&]() TESLA_TARGET_SSE2
+	{
+		for (Edge& edge : edges)
+		{
+			edge.lo = _mm_add_epi64(edge.lo, edge.step);
+			edge.hi = _mm_add_epi64(edge.hi, edge.step);
+		}
+		for (int k = 0; k < nFixed; k++)
+		{
+			fixed[k] = _mm_add_epi32(fixed[k], dfixed[k]);
+		}
+	};
+
+	// Lane offsets from the AABB origin, stepped 4 pixels at a time
+	__m128i ix = _mm_add_epi32(_mm_set1_epi32(xStart - tri.xStart), _mm_setr_epi32(0, 1, 2, 3));
+	const __m128i four = _mm_set1_epi32(4);
+
+	// The 4 packed colors of the covered lanes
+	auto Shade = [&](__m128 fx) TESLA_TARGET_SSE2 -> __m128i
+	{
+		if constexpr (type == Triangle::Type::Flat)
+		{
+			return _mm_set1_epi32((int)tri.c.dword);
+		}
+		else if constexpr (type == Triangle::Type::Gradient)
+		{
+			// Integer parts saturated to bytes by the packs (b0-3 g0-3 r0-3 0-3),
+			// then interleaved into pixels by two unpacks
+			const __m128i r = _mm_srai_epi32(fixed[0], 16);
+			const __m128i g = _mm_srai_epi32(fixed[1], 16);
+			const __m128i b = _mm_srai_epi32(fixed[2], 16);
+			const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(b, g), _mm_packs_epi32(r, _mm_setzero_si128()));
+			const __m128i brgx  = _mm_unpacklo_epi8(bytes, _mm_srli_si128(bytes, 8));
+			return _mm_unpacklo_epi8(brgx, _mm_srli_si128(brgx, 8));
+		}
+		else if constexpr (type == Triangle::Type::TexturedFixed)
+		{
+			// Integer parts of the texel coordinates through the address mode, no gather in SSE2
+			const Surface::MipLevel& mip = mips[0];
+			alignas(16) int tx[4];
+			alignas(16) int ty[4];
+			_mm_store_si128((__m128i*)tx, AddressTexels4SSE2<address>(_mm_srai_epi32(fixed[0], 16), mip.width));
+			_mm_store_si128((__m128i*)ty, AddressTexels4SSE2<address>(_mm_srai_epi32(fixed[1], 16), mip.height));
+			auto Texel = [&](int i) TESLA_TARGET_SSE2
+			{
+				return (int)mip.pPixels[mip.RowOffset(ty[i]) + mip.ColumnOffset(tx[i])].dword;
+			};
+			return _mm_setr_epi32(Texel(0), Texel(1), Texel(2), Texel(3));
+		}
+		else
+		{
+			const __m128 uRow = _mm_set1_ps(tri.uv.x + tri.duvdy.x * fy);
+			const __m128 vRow = _mm_set1_ps(tri.uv.y + tri.duvdy.y * fy);
+			__m128 u, v;
+			if constexpr (type == Triangle::Type::Textured)
+			{
+				u = _mm_add_ps(uRow, _mm_mul_ps(_mm_set1_ps(tri.duvdx.x), fx));
+				v = _mm_add_ps(vRow, _mm_mul_ps(_mm_set1_ps(tri.duvdx.y), fx));
+			}
+			else
+			{
+				// Same as the scalar kernel: exact uv at both ends of the span of every lane
+				const __m128 qRow = _mm_set1_ps(tri.q + tri.dqdy * fy);
+				auto Exact = [&](__m128 fa, __m128& uOut, __m128& vOut) TESLA_TARGET_SSE2
+				{
+					const __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(_mm_add_ps(qRow, _mm_mul_ps(_mm_set1_ps(tri.dqdx), fa)), _mm_set1_ps(tri.qMin)));
+					uOut = _mm_mul_ps(_mm_add_ps(uRow, _mm_mul_ps(_mm_set1_ps(tri.duvdx.x), fa)), w);
+					vOut = _mm_mul_ps(_mm_add_ps(vRow, _mm_mul_ps(_mm_set1_ps(tri.duvdx.y), fa)), w);
+				};
+				const __m128i k  = _mm_and_si128(ix, _mm_set1_epi32(PerspectiveSpan - 1));
+				const __m128 fa  = _mm_cvtepi32_ps(_mm_sub_epi32(ix, k));
+				__m128 uStart, vStart, uEnd, vEnd;
+				Exact(fa, uStart, vStart);
+				Exact(_mm_add_ps(fa, _mm_set1_ps(float(PerspectiveSpan))), uEnd, vEnd);
+				const __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(k), _mm_set1_ps(1.0f / float(PerspectiveSpan)));
+				u = _mm_add_ps(uStart, _mm_mul_ps(_mm_sub_ps(uEnd, uStart), t));
+				v = _mm_add_ps(vStart, _mm_mul_ps(_mm_sub_ps(vEnd, vStart), t));
+			}
+			switch (tri.filter)
+			{
+			case Surface::Filter::Point:
+				return SamplePoint4SSE2(mips[0], u, v);
+			case Surface::Filter::Bilinear:
+				return SampleBilinear4SSE2(mips[0], u, v);
+			default:
+				return Lerp4SSE2(SampleBilinear4SSE2(mips[0], u, v), SampleBilinear4SSE2(mips[1], u, v), mipWeight);
+			}
+		}
+	};
+
+	auto Coverage = [&]() TESLA_TARGET_SSE2 -> __m128
+	{
+		if constexpr (covered)
+		{
+			return _mm_castsi128_ps(_mm_set1_epi32(-1));
+		}
+		const __m128i lo = _mm_or_si128(_mm_or_si128(edges[0].lo, edges[1].lo), edges[2].lo);
+		const __m128i hi = _mm_or_si128(_mm_or_si128(edges[0].hi, edges[1].hi), edges[2].hi);
+		// The sign bits are in the high dword of every 64 bit value
+		const __m128 high = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+		return _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_castps_si128(high), _mm_set1_epi32(-1)));
+	};
+
+	int x = xStart;
+	for (; x + 3 <= xEnd; x += 4, ix = _mm_add_epi32(ix, four), Step())
+	{
+		const __m128 fx = _mm_cvtepi32_ps(ix);
+		const __m128 mask = Coverage();
+		const int bits = _mm_movemask_ps(mask);
+		if (bits == 0)
+		{
+			continue;
+		}
+		__m128i* const pDst = (__m128i*)(pRow + x);
+		if (bits == 0xF)
+		{
+			_mm_storeu_si128(pDst, Shade(fx));
+		}
+		else
+		{
+			// All 4 lanes are inside [xStart, xEnd], so this read-modify-write stays in our tile
+			const __m128i m = _mm_castps_si128(mask);
+			const __m128i dst = _mm_loadu_si128(pDst);
+			_mm_storeu_si128(pDst, _mm_or_si128(_mm_and_si128(m, Shade(fx)), _mm_andnot_si128(m, dst)));
+		}
+	}
+
+	// Tail: lanes past xEnd may belong to another tile, so write the covered ones one by one
+	if (x <= xEnd)
+	{
+		const __m128 fx = _mm_cvtepi32_ps(ix);
+		const int bits = _mm_movemask_ps(Coverage());
+		if (bits != 0)
+		{
+			alignas(16) unsigned int colors[4];
+			_mm_store_si128((__m128i*)colors, Shade(fx));
+			for (int i = 0; x + i <= xEnd; i++)
+			{
+				if (bits & (1 << i))
+				{
+					pRow[x + i] = colors[i];
+				}
+			}
+		}
+	}
+}
+
+/*************************************************************************************/
+/************************************** AVX2 *****************************************/
+template<Rasterizer::Triangle::Type type, bool covered, Surface::AddressMode address>
+TESLA_TARGET_AVX2 void Rasterizer::RasterizeRowAVX2(const Triangle& tri, Color* pRow, int y, int xStart, int xEnd)
+{
+	if constexpr (covered && type == Triangle::Type::Flat)
+	{
+		Surface::FillSpan(pRow, xStart, xEnd + 1, tri.c);
+		return;
+	}
+
+	const float fy = float(y - tri.yStart);
+
+	// Texture levels of the sampling, and the weight of the second one
+	Surface::MipLevel mips[2] = {};
+	__m256i mipWeight = _mm256_setzero_si256();
+	if constexpr (type == Triangle::Type::Textured || type == Triangle::Type::TexturedFixed || type == Triangle::Type::TexturedPerspective)
+	{
+		mips[0] = tri.pTex->GetMip(tri.mipLevel);
+		if (tri.filter == Surface::Filter::Trilinear)
+		{
+			mips[1]   = tri.pTex->GetMip(tri.mipLevel + 1u);
+			mipWeight = _mm256_set1_epi32(int(tri.mipWeight));
+		}
+	}
+
+	// Fixed point attributes of the 8 lanes in 16.16 (gradient R, G and B, or texel x and y),
+	// stepped 8 pixels at a time
+	constexpr int nFixed = type == Triangle::Type::Gradient ? 3 : type == Triangle::Type::TexturedFixed ? 2 : 0;
+	__m256i fixed[3];
+	__m256i dfixed[3];
+	for (int k = 0; k < nFixed; k++)
+	{
+		const unsigned int c = type == Triangle::Type::Gradient ? tri.GradientAt(k, xStart, y) : tri.TexelAt(k, xStart, y);
+		const unsigned int d = type == Triangle::Type::Gradient ? tri.drgbdx[k] : tri.dtexeldx[k];
+		fixed[k]  = _mm256_add_epi32(_mm256_set1_epi32(int(c)), _mm256_mullo_epi32(_mm256_set1_epi32(int(d)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+		dfixed[k] = _mm256_set1_epi32(int(8u * d));
+	}
+
+	// Edge functions of the 8 lanes as two quads of 64 bit values (lanes 0-3 and 4-7)
+	struct Edge
+	{
+		__m256i lo;
+		__m256i hi;
+		__m256i step;
+	};
+	auto SetupEdge = [&](long long e, long long dedx, long long dedy) TESLA_TARGET_AVX2 -> Edge
+	{
+		e += dedy * (y - tri.yStart) + dedx * (xStart - tri.xStart);
+		return {
+			_mm256_set_epi64x(e + 3 * dedx, e + 2 * dedx, e + dedx, e),
+			_mm256_set_epi64x(e + 7 * dedx, e + 6 * dedx, e + 5 * dedx, e + 4 * dedx),
+			_mm256_set1_epi64x(8 * dedx)
+		};
+	};
+	Edge edges[3] = {
+		SetupEdge(tri.e0, tri.de0dx, tri.de0dy),
+		SetupEdge(tri.e1, tri.de1dx, tri.de1dy),
+		SetupEdge(tri.e2, tri.de2dx, tri.de2dy)
+	};
+	auto Step = [&]() TESLA_TARGET_AVX2
+	{
+		for (Edge& edge : edges)
+		{
+			edge.lo = _mm256_add_epi64(edge.lo, edge.step);
+			edge.hi = _mm256_add_epi64(edge.hi, edge.step);
+		}
+		for (int k = 0; k < nFixed; k++)
+		{
+			fixed[k] = _mm256_add_epi32(fixed[k], dfixed[k]);
+		}
+	};
+
+	// Lane offsets from the AABB origin, stepped 8 pixels at a time
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i ix = _mm256_add_epi32(_mm256_set1_epi32(xStart - tri.xStart), lanes);
+	const __m256i eight = _mm256_set1_epi32(8);
+
+	// The 8 packed colors of the covered lanes
+	auto Shade = [&](__m256 fx) TESLA_TARGET_AVX2 -> __m256i
+	{
+		if constexpr (type == Triangle::Type::Flat)
+		{
+			return _mm256_set1_epi32((int)tri.c.dword);
+		}
+		else if constexpr (type == Triangle::Type::Gradient)
+		{
+			// Same saturating packs and unpacks as SSE2, in each 128 bit half
+			const __m256i r = _mm256_srai_epi32(fixed[0], 16);
+			const __m256i g = _mm256_srai_epi32(fixed[1], 16);
+			const __m256i b = _mm256_srai_epi32(fixed[2], 16);
+			const __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(b, g), _mm256_packs_epi32(r, _mm256_setzero_si256()));
+			const __m256i brgx  = _mm256_unpacklo_epi8(bytes, _mm256_srli_si256(bytes, 8));
+			return _mm256_unpacklo_epi8(brgx, _mm256_srli_si256(brgx, 8));
+		}
+		else if constexpr (type == Triangle::Type::TexturedFixed)
+		{
+			const Surface::MipLevel& mip = mips[0];
+			const __m256i tx = AddressTexels8AVX2<address>(_mm256_srai_epi32(fixed[0], 16), mip.width);
+			const __m256i ty = AddressTexels8AVX2<address>(_mm256_srai_epi32(fixed[1], 16), mip.height);
+			const __m256i index = _mm256_add_epi32(RowOffset8AVX2(mip, ty), ColumnOffset8AVX2(mip, tx));
+			return _mm256_i32gather_epi32((const int*)mip.pPixels, index, 4);
+		}
+		else
+		{
+			const __m256 uRow = _mm256_set1_ps(tri.uv.x + tri.duvdy.x * fy);
+			const __m256 vRow = _mm256_set1_ps(tri.uv.y + tri.duvdy.y * fy);
+			__m256 u, v;
+			if constexpr (type == Triangle::Type::Textured)
+			{
+				u = _mm256_add_ps(uRow, _mm256_mul_ps(_mm256_set1_ps(tri.duvdx.x), fx));
+				v = _mm256_add_ps(vRow, _mm256_mul_ps(_mm256_set1_ps(tri.duvdx.y), fx));
+			}
+			else
+			{
+				// Same as the scalar kernel: exact uv at both ends of the span of every lane
+				const __m256 qRow = _mm256_set1_ps(tri.q + tri.dqdy * fy);
+				auto Exact = [&](__m256 fa, __m256& uOut, __m256& vOut) TESLA_TARGET_AVX2
+				{
+					const __m256 w = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(_mm256_add_ps(qRow, _mm256_mul_ps(_mm256_set1_ps(tri.dqdx), fa)), _mm256_set1_ps(tri.qMin)));
+					uOut = _mm256_mul_ps(_mm256_add_ps(uRow, _mm256_mul_ps(_mm256_set1_ps(tri.duvdx.x), fa)), w);
+					vOut = _mm256_mul_ps(_mm256_add_ps(vRow, _mm256_mul_ps(_mm256_set1_ps(tri.duvdx.y), fa)), w);
+				};
+				const __m256i k  = _mm256_and_si256(ix, _mm256_set1_epi32(PerspectiveSpan - 1));
+				const __m256 fa  = _mm256_cvtepi32_ps(_mm256_sub_epi32(ix, k));
+				__m256 uStart, vStart, uEnd, vEnd;
+				Exact(fa, uStart, vStart);
+				Exact(_mm256_add_ps(fa, _mm256_set1_ps(float(PerspectiveSpan))), uEnd, vEnd);
+				const __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(k), _mm256_set1_ps(1.0f / float(PerspectiveSpan)));
+				u = _mm256_add_ps(uStart, _mm256_mul_ps(_mm256_sub_ps(uEnd, uStart), t));
+				v = _mm256_add_ps(vStart, _mm256_mul_ps(_mm256_sub_ps(vEnd, vStart), t));
+			}
+			switch (tri.filter)
+			{
+			case Surface::Filter::Point:
+				return SamplePoint8AVX2(mips[0], u, v);
+			case Surface::Filter::Bilinear:
+				return SampleBilinear8AVX2(mips[0], u, v);
+			default:
+				return Lerp8AVX2(SampleBilinear8AVX2(mips[0], u, v), SampleBilinear8AVX2(mips[1], u, v), mipWeight);
+			}
+		}
+	};
+
+	auto Coverage = [&]() TESLA_TARGET_AVX2 -> __m256
+	{
+		if constexpr (covered)
+		{
+			return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		}
+		const __m256i lo = _mm256_or_si256(_mm256_or_si256(edges[0].lo, edges[1].lo), edges[2].lo);
+		const __m256i hi = _mm256_or_si256(_mm256_or_si256(edges[0].hi, edges[1].hi), edges[2].hi);
+		// The sign bits are in the high dword of every 64 bit value: the shuffle
+		// collects them as lanes 0 1 4 5 | 2 3 6 7, the permute restores the order
+		const __m256 high = _mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+		const __m256i signs = _mm256_permute4x64_epi64(_mm256_castps_si256(high), _MM_SHUFFLE(3, 1, 2, 0));
+		return _mm256_castsi256_ps(_mm256_cmpgt_epi32(signs, _mm256_set1_epi32(-1)));
+	};
+
+	for (int x = xStart; x <= xEnd; x += 8, ix = _mm256_add_epi32(ix, eight), Step())
+	{
+		const __m256 fx = _mm256_cvtepi32_ps(ix);
+		__m256 mask = Coverage();
+		if (x + 7 > xEnd)
+		{
+			// Lanes past xEnd may belong to another tile: mask them out of the store
+			const __m256i inRange = _mm256_cmpgt_epi32(_mm256_set1_epi32(xEnd - x + 1), lanes);
+			mask = _mm256_and_ps(mask, _mm256_castsi256_ps(inRange));
+		}
+		const int bits = _mm256_movemask_ps(mask);
+		if (bits == 0)
+		{
+			continue;
+		}
+		if (bits == 0xFF)
+		{
+			_mm256_storeu_si256((__m256i*)(pRow + x), Shade(fx));
+		}
+		else
+		{
+			_mm256_maskstore_epi32((int*)(pRow + x), _mm256_castps_si256(mask), Shade(fx));
+		}
+	}
+	_mm256_zeroupper();
+}
+#endif
+
+/*************************************************************************************/
+/********************************* LINE CLASSIFIERS **********************************/
+// A segment is Inside when both endpoints are in [0, size - 1] on both axes and Rejected when
+// both are below -1 or at/after size on one axis: the DDA samples at v + 0.5, so none of its
+// pixels can land in the target then. Everything else goes through the clipping setup
+void Rasterizer::ClassifyLines(LineBatch& batch, int count, float width, float height)
+{
+	for (int i = 0; i < count; i++)
+	{
+		const float xMin = std::min(batch.x0[i], batch.x1[i]);
+		const float xMax = std::max(batch.x0[i], batch.x1[i]);
+		const float yMin = std::min(batch.y0[i], batch.y1[i]);
+		const float yMax = std::max(batch.y0[i], batch.y1[i]);
+		const bool inside   = xMin >= 0.0f && xMax <= width - 1.0f && yMin >= 0.0f && yMax <= height - 1.0f;
+		const bool rejected = xMax < -1.0f || xMin >= width || yMax < -1.0f || yMin >= height;
+		batch.cls[i] = inside ? LineClass::Inside : rejected ? LineClass::Rejected : LineClass::Clipped;
+	}
+}
+
+#ifdef TESLA_SIMD_X86
+TESLA_TARGET_SSE2 void Rasterizer::ClassifyLinesSSE2(LineBatch& batch, int count, float width, float height)
+{
+	const __m128 zero     = _mm_setzero_ps();
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 w        = _mm_set1_ps(width);
+	const __m128 h        = _mm_set1_ps(height);
+	const __m128 wLast    = _mm_set1_ps(width - 1.0f);
+	const __m128 hLast    = _mm_set1_ps(height - 1.0f);
+	for (int i = 0; i < count; i += 4)
+	{
+		const __m128 x0 = _mm_load_ps(batch.x0 + i);
+		const __m128 y0 = _mm_load_ps(batch.y0 + i);
+		const __m128 x1 = _mm_load_ps(batch.x1 + i);
+		const __m128 y1 = _mm_load_ps(batch.y1 + i);
+		const __m128 xMin = _mm_min_ps(x0, x1);
+		const __m128 xMax = _mm_max_ps(x0, x1);
+		const __m128 yMin = _mm_min_ps(y0, y1);
+		const __m128 yMax = _mm_max_ps(y0, y1);
+		const __m128 inside = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(xMin, zero), _mm_cmple_ps(xMax, wLast)),
+			_mm_and_ps(_mm_cmpge_ps(yMin, zero), _mm_cmple_ps(yMax, hLast)));
+		const __m128 rejected = _mm_or_ps(
+			_mm_or_ps(_mm_cmplt_ps(xMax, minusOne), _mm_cmpge_ps(xMin, w)),
+			_mm_or_ps(_mm_cmplt_ps(yMax, minusOne), _mm_cmpge_ps(yMin, h)));
+
+		// Clipped (1) + 1 when inside - 1 when rejected, the two can't be both set
+		const int insideBits   = _mm_movemask_ps(inside);
+		const int rejectedBits = _mm_movemask_ps(rejected);
+		for (int k = 0; k < 4 && i + k < count; k++)
+		{
+			batch.cls[i + k] = LineClass(1 + ((insideBits >> k) & 1) - ((rejectedBits >> k) & 1));
+		}
+	}
+}
+
+TESLA_TARGET_AVX2 void Rasterizer::ClassifyLinesAVX2(LineBatch& batch, int count, float width, float height)
+{
+	const __m256 zero     = _mm256_setzero_ps();
+	const __m256 minusOne = _mm256_set1_ps(-1.0f);
+	const __m256 w        = _mm256_set1_ps(width);
+	const __m256 h        = _mm256_set1_ps(height);
+	const __m256 wLast    = _mm256_set1_ps(width - 1.0f);
+	const __m256 hLast    = _mm256_set1_ps(height - 1.0f);
+	for (int i = 0; i < count; i += 8)
+	{
+		const __m256 x0 = _mm256_load_ps(batch.x0 + i);
+		const __m256 y0 = _mm256_load_ps(batch.y0 + i);
+		const __m256 x1 = _mm256_load_ps(batch.x1 + i);
+		const __m256 y1 = _mm256_load_ps(batch.y1 + i);
+		const __m256 xMin = _mm256_min_ps(x0, x1);
+		const __m256 xMax = _mm256_max_ps(x0, x1);
+		const __m256 yMin = _mm256_min_ps(y0, y1);
+		const __m256 yMax = _mm256_max_ps(y0, y1);
+		const __m256 inside = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(xMin, zero, _CMP_GE_OQ), _mm256_cmp_ps(xMax, wLast, _CMP_LE_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(yMin, zero, _CMP_GE_OQ), _mm256_cmp_ps(yMax, hLast, _CMP_LE_OQ)));
+		const __m256 rejected = _mm256_or_ps(
+			_mm256_or_ps(_mm256_cmp_ps(xMax, minusOne, _CMP_LT_OQ), _mm256_cmp_ps(xMin, w, _CMP_GE_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(yMax, minusOne, _CMP_LT_OQ), _mm256_cmp_ps(yMin, h, _CMP_GE_OQ)));
+
+		const int insideBits   = _mm256_movemask_ps(inside);
+		const int rejectedBits = _mm256_movemask_ps(rejected);
+		for (int k = 0; k < 8 && i + k < count; k++)
+		{
+			batch.cls[i + k] = LineClass(1 + ((insideBits >> k) & 1) - ((rejectedBits >> k) & 1));
+		}
+	}
+	_mm256_zeroupper();
+}
+#endif
+
+/*************************************************************************************/
+/******************************** KERNEL SELECTION ***********************************/
+const Rasterizer::RowKernels& Rasterizer::GetRowKernels(bool covered) noexcept
+{
+	using Type = Triangle::Type;
+	using Address = Surface::AddressMode;
+	auto Select = [](auto tag) -> RowKernels
+	{
+		constexpr bool c = decltype(tag)::value;
+#ifdef TESLA_SIMD_X86
+		if (TeslaCPU::HasAVX2())
+		{
+			return {
+				&RasterizeRowAVX2<Type::Flat, c>, &RasterizeRowAVX2<Type::Gradient, c>, &RasterizeRowAVX2<Type::Textured, c>, &RasterizeRowAVX2<Type::TexturedPerspective, c>,
+				{ &RasterizeRowAVX2<Type::TexturedFixed, c, Address::Clamp>, &RasterizeRowAVX2<Type::TexturedFixed, c, Address::Wrap>, &RasterizeRowAVX2<Type::TexturedFixed, c, Address::Mirror> }
+			};
+		}
+		if (TeslaCPU::HasSSE2())
+		{
+			return {
+				&RasterizeRowSSE2<Type::Flat, c>, &RasterizeRowSSE2<Type::Gradient, c>, &RasterizeRowSSE2<Type::Textured, c>, &RasterizeRowSSE2<Type::TexturedPerspective, c>,
+				{ &RasterizeRowSSE2<Type::TexturedFixed, c, Address::Clamp>, &RasterizeRowSSE2<Type::TexturedFixed, c, Address::Wrap>, &RasterizeRowSSE2<Type::TexturedFixed, c, Address::Mirror> }
+			};
+		}
+#endif
+		return {
+			&RasterizeRow<Type::Flat, c>, &RasterizeRow<Type::Gradient, c>, &RasterizeRow<Type::Textured, c>, &RasterizeRow<Type::TexturedPerspective, c>,
+			{ &RasterizeRow<Type::TexturedFixed, c, Address::Clamp>, &RasterizeRow<Type::TexturedFixed, c, Address::Wrap>, &RasterizeRow<Type::TexturedFixed, c, Address::Mirror> }
+		};
+	};
+	static const RowKernels partialKernels = Select(std::false_type{});
+	static const RowKernels coveredKernels = Select(std::true_type{});
+	return covered ? coveredKernels : partialKernels;
+}
+
+Rasterizer::LineClassifier Rasterizer::GetLineClassifier() noexcept
+{
+#ifdef TESLA_SIMD_X86
+	if (TeslaCPU::HasAVX2())
+	{
+		return &ClassifyLinesAVX2;
+	}
+	if (TeslaCPU::HasSSE2())
+	{
+		return &ClassifyLinesSSE2;
+	}
+#endif
+	return &ClassifyLines;
+}
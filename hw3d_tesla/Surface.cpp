@@ -1,17 +1,31 @@
-#define FULL_WINTARD
 #include "Surface.h"
-#include "TeslaWin.h"
+#include "TeslaCPU.h"
 #include <algorithm>
+#include <sstream>
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+
+#ifdef TESLA_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Image I/O goes through GDIPlus on Windows. Everywhere else (headless render farms)
+// only the raw pixel operations and the .bmp writer are available
+#ifdef _WIN32
+#define FULL_WINTARD
+#include "TeslaWin.h"
 namespace Gdiplus
 {
 	using std::min;
 	using std::max;
 }
 #include <gdiplus.h>
-#include <sstream>
-#include <cassert>
 
 #pragma comment(lib, "gdiplus.lib")
+#else
+#include <fstream>
+#endif
 
 Surface::Surface(unsigned int width, unsigned int height, unsigned int pitch) noexcept
 	:
@@ -36,26 +50,104 @@ Surface::Surface(Surface&& source) noexcept
 	:
 	pBuffer(std::move(source.pBuffer)),
 	width(source.width),
-	height(source.height)
+	height(source.height),
+	layout(source.layout),
+	pMipBuffer(std::move(source.pMipBuffer)),
+	mips(std::move(source.mips))
 {}
 
 Surface& Surface::operator=(Surface&& donor) noexcept
 {
 	width = donor.width;
 	height = donor.height;
+	layout = donor.layout;
 	pBuffer = std::move(donor.pBuffer);
 	donor.pBuffer = nullptr;
+	pMipBuffer = std::move(donor.pMipBuffer);
+	mips = std::move(donor.mips);
+	donor.mips.clear();
 	return *this;
 }
 
+// Texels of a level stored in the layout, Tiled pads both sizes to whole blocks
+static unsigned int LayoutPitch(unsigned int width, Surface::Layout layout) noexcept
+{
+	return layout == Surface::Layout::Tiled ? ((width + 3u) & ~3u) * 4u : width;
+}
+
+static size_t LayoutPixelCount(unsigned int width, unsigned int height, Surface::Layout layout) noexcept
+{
+	return (size_t)LayoutPitch(width, layout) * (layout == Surface::Layout::Tiled ? (height + 3u) / 4u : height);
+}
+
+#ifdef TESLA_SIMD_X86
+TESLA_TARGET_SSE2 static void ClearStreamSSE2(Color* pStart, Color* pEnd, Color c) noexcept
+{
+	// Single pixels up to the 16 byte boundary, then 16 pixels per iteration with non-temporal
+	// stores: a large clear goes straight to memory instead of evicting the whole cache
+	while (pStart < pEnd && (reinterpret_cast<uintptr_t>(pStart) & 15u) != 0u)
+	{
+		*pStart++ = c;
+	}
+	const __m128i value = _mm_set1_epi32((int)c.dword);
+	for (; pEnd - pStart >= 16; pStart += 16)
+	{
+		_mm_stream_si128(reinterpret_cast<__m128i*>(pStart), value);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(pStart + 4), value);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(pStart + 8), value);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(pStart + 12), value);
+	}
+	for (; pStart < pEnd; pStart++)
+	{
+		*pStart = c;
+	}
+	// Streaming stores are weakly ordered, make them visible before anybody reads the pixels
+	_mm_sfence();
+}
+#endif
+
 void Surface::Clear(Color fillvalue) noexcept
 {
-	Color* pStart = pBuffer.get();
-	Color* pEnd = &pBuffer[(size_t)width * height];
+	// Below this size the surface most likely fits in the cache, and it is better to keep it there
+	static constexpr size_t streamingThreshold = size_t(1) << 20;
+
+	const size_t nPixels = LayoutPixelCount(width, height, layout);
+#ifdef TESLA_SIMD_X86
+	if (nPixels * sizeof(Color) >= streamingThreshold && TeslaCPU::HasSSE2())
+	{
+		ClearStreamSSE2(pBuffer.get(), pBuffer.get() + nPixels, fillvalue);
+		return;
+	}
+#endif
+	if (layout == Layout::Tiled)
+	{
+		FillSpan(pBuffer.get(), 0, (int)nPixels, fillvalue);
+		return;
+	}
+	for (size_t y = 0; y < height; y++)
+	{
+		FillSpan(&pBuffer[width * y], 0, (int)width, fillvalue);
+	}
+}
+
+void Surface::ClearRect(const Rect& rect, Color fillvalue) noexcept
+{
+	assert(layout == Layout::Linear && "Row access to a tiled surface");
+	const int left   = std::max(rect.left, 0);
+	const int top    = std::max(rect.top, 0);
+	const int right  = std::min(rect.right, (int)width);
+	const int bottom = std::min(rect.bottom, (int)height);
+	for (int y = top; y < bottom; y++)
+	{
+		FillSpan(&pBuffer[(size_t)width * y], left, right, fillvalue);
+	}
+}
 
-	for (Color* c = pStart; c < pEnd; c++)
+void Surface::ClearRegions(std::span<const Rect> rects, Color fillvalue) noexcept
+{
+	for (const Rect& rect : rects)
 	{
-		*c = fillvalue;
+		ClearRect(rect, fillvalue);
 	}
 }
 
@@ -65,7 +157,7 @@ void Surface::PutPixel(int x, int y, Color c) noexcept
 	assert(x < width && "Attempting to draw outside the surface");
 	assert(y >= 0 && "Attempting to draw outside the surface");
 	assert(y < height && "Attempting to draw outside the surface");
-	pBuffer[x + (size_t)width * y] = c;
+	pBuffer[TexelOffset(x, y)] = c;
 }
 
 Color Surface::GetPixel(unsigned int x, unsigned int y) const noexcept
@@ -74,14 +166,155 @@ Color Surface::GetPixel(unsigned int x, unsigned int y) const noexcept
 	assert(x < width && "Attempting sample outside the surface");
 	assert(y >= 0u && "Attempting sample outside the surface");
 	assert(y < height && "Attempting sample outside the surface");
-	return pBuffer[x + (size_t)width * y];
+	return pBuffer[TexelOffset(x, y)];
 }
 
-Color Surface::Sample(float u, float v) const noexcept
+size_t Surface::TexelOffset(unsigned int x, unsigned int y) const noexcept
 {
-	const unsigned int x = std::clamp((unsigned int)(u * float(width - 1u)) , 0u, width  - 1u);
-	const unsigned int y = std::clamp((unsigned int)(v * float(height - 1u)), 0u, height - 1u);
-	return GetPixel(x, y);
+	if (layout == Layout::Linear)
+	{
+		return x + (size_t)width * y;
+	}
+	const MipLevel mip = GetMip(0u);
+	return mip.RowOffset(y) + mip.ColumnOffset(x);
+}
+
+void Surface::SetLayout(Layout newLayout)
+{
+	if (newLayout == layout)
+	{
+		return;
+	}
+	const MipLevel src = GetMip(0u);
+	const MipLevel dst = { nullptr, width, height, newLayout, LayoutPitch(width, newLayout) };
+	auto pNewBuffer = std::make_unique<Color[]>(LayoutPixelCount(width, height, newLayout));
+	for (unsigned int y = 0u; y < height; y++)
+	{
+		for (unsigned int x = 0u; x < width; x++)
+		{
+			pNewBuffer[dst.RowOffset(y) + dst.ColumnOffset(x)] = src.pPixels[src.RowOffset(y) + src.ColumnOffset(x)];
+		}
+	}
+	pBuffer = std::move(pNewBuffer);
+	layout  = newLayout;
+	if (!mips.empty())
+	{
+		GenerateMips();
+	}
+}
+
+Surface::Layout Surface::GetLayout() const noexcept
+{
+	return layout;
+}
+
+void Surface::GenerateMips()
+{
+	// Level sizes first, so the whole chain fits in one allocation
+	std::vector<MipLevel> levels;
+	size_t nPixels = 0u;
+	for (unsigned int w = width, h = height; w > 1u || h > 1u;)
+	{
+		w = std::max(w / 2u, 1u);
+		h = std::max(h / 2u, 1u);
+		levels.push_back({ nullptr, w, h, layout, LayoutPitch(w, layout) });
+		nPixels += LayoutPixelCount(w, h, layout);
+	}
+	pMipBuffer = std::make_unique<Color[]>(nPixels);
+
+	// Rounded average of 4 colors, two bytes at a time: the 16 bit lanes hold up to 4 * 255 + 2
+	auto Average = [](Color a, Color b, Color c, Color d)
+	{
+		constexpr unsigned int mask = 0x00FF00FFu;
+		const unsigned int lo = (a.dword & mask) + (b.dword & mask) + (c.dword & mask) + (d.dword & mask) + 0x00020002u;
+		const unsigned int hi = ((a.dword >> 8u) & mask) + ((b.dword >> 8u) & mask) + ((c.dword >> 8u) & mask) + ((d.dword >> 8u) & mask) + 0x00020002u;
+		return Color(((lo >> 2u) & mask) | ((hi << 6u) & ~mask));
+	};
+
+	// Odd sizes repeat the last row or column of the level above
+	Color* pLevel = pMipBuffer.get();
+	MipLevel src = GetMip(0u);
+	for (MipLevel& dst : levels)
+	{
+		for (unsigned int y = 0u; y < dst.height; y++)
+		{
+			const Color* pRow0 = src.pPixels + src.RowOffset(std::min(2u * y, src.height - 1u));
+			const Color* pRow1 = src.pPixels + src.RowOffset(std::min(2u * y + 1u, src.height - 1u));
+			Color* pDst = pLevel + dst.RowOffset(y);
+			for (unsigned int x = 0u; x < dst.width; x++)
+			{
+				const size_t x0 = src.ColumnOffset(std::min(2u * x, src.width - 1u));
+				const size_t x1 = src.ColumnOffset(std::min(2u * x + 1u, src.width - 1u));
+				pDst[dst.ColumnOffset(x)] = Average(pRow0[x0], pRow0[x1], pRow1[x0], pRow1[x1]);
+			}
+		}
+		dst.pPixels = pLevel;
+		pLevel += LayoutPixelCount(dst.width, dst.height, dst.layout);
+		src = dst;
+	}
+	mips = std::move(levels);
+}
+
+void Surface::ReleaseMips() noexcept
+{
+	mips.clear();
+	pMipBuffer.reset();
+}
+
+unsigned int Surface::GetMipCount() const noexcept
+{
+	return unsigned(mips.size()) + 1u;
+}
+
+Surface::MipLevel Surface::GetMip(unsigned int level) const noexcept
+{
+	assert(level < GetMipCount() && "Mip level out of the chain");
+	return level == 0u ? MipLevel{ pBuffer.get(), width, height, layout, LayoutPitch(width, layout) } : mips[level - 1u];
+}
+
+Color Surface::Sample(float u, float v, unsigned int level) const noexcept
+{
+	// Clamp before the conversion: negative floats don't fit in an unsigned int
+	const MipLevel mip = GetMip(level);
+	const unsigned int x = (unsigned int)std::clamp(u * float(mip.width  - 1u), 0.0f, float(mip.width  - 1u));
+	const unsigned int y = (unsigned int)std::clamp(v * float(mip.height - 1u), 0.0f, float(mip.height - 1u));
+	return mip.pPixels[mip.RowOffset(y) + mip.ColumnOffset(x)];
+}
+
+Color Surface::SampleBilinear(float u, float v, unsigned int level) const noexcept
+{
+	// Top-left texel of the 2x2 block and the weights of the right and bottom ones in 1/256.
+	// The row kernels of the Rasterizer repeat these float operations in SIMD lanes
+	const MipLevel mip = GetMip(level);
+	const float xMax = float(mip.width  - 1u);
+	const float yMax = float(mip.height - 1u);
+	const float x = std::clamp(u * xMax, 0.0f, xMax);
+	const float y = std::clamp(v * yMax, 0.0f, yMax);
+	const unsigned int x0 = (unsigned int)x;
+	const unsigned int y0 = (unsigned int)y;
+	const unsigned int fx = (unsigned int)((x - float(x0)) * 256.0f);
+	const unsigned int fy = (unsigned int)((y - float(y0)) * 256.0f);
+	const size_t x1 = mip.ColumnOffset(std::min(x0 + 1u, mip.width  - 1u));
+	const size_t y1 = mip.RowOffset(std::min(y0 + 1u, mip.height - 1u));
+	const Color* pRow0 = mip.pPixels + mip.RowOffset(y0);
+	const Color* pRow1 = mip.pPixels + y1;
+	const size_t c0 = mip.ColumnOffset(x0);
+	return Lerp(Lerp(pRow0[c0], pRow0[x1], fx), Lerp(pRow1[c0], pRow1[x1], fx), fy);
+}
+
+Color Surface::SampleTrilinear(float u, float v, unsigned int level, unsigned int weight) const noexcept
+{
+	assert(level + 1u < GetMipCount() && "Trilinear sampling needs the next mip level");
+	return Lerp(SampleBilinear(u, v, level), SampleBilinear(u, v, level + 1u), weight);
+}
+
+Color Surface::Lerp(Color a, Color b, unsigned int weight) noexcept
+{
+	// Two bytes at a time, the 16 bit lanes hold up to 255 * 256
+	constexpr unsigned int mask = 0x00FF00FFu;
+	const unsigned int lo = (a.dword & mask) * (256u - weight) + (b.dword & mask) * weight;
+	const unsigned int hi = ((a.dword >> 8u) & mask) * (256u - weight) + ((b.dword >> 8u) & mask) * weight;
+	return Color(((lo >> 8u) & mask) | (hi & ~mask));
 }
 
 unsigned int Surface::GetWidth() const noexcept
@@ -104,6 +337,332 @@ const Color* Surface::GetBufferPtrConst() const noexcept
 	return pBuffer.get();
 }
 
+Color* Surface::GetRowPtr(unsigned int y) const noexcept
+{
+	assert(y < height && "Attempting to access a row outside the surface");
+	assert(layout == Layout::Linear && "Row access to a tiled surface");
+	return &pBuffer[(size_t)width * y];
+}
+
+#ifdef TESLA_SIMD_X86
+TESLA_TARGET_SSE2 static void FillSpanSSE2(Color* pStart, Color* pEnd, Color c) noexcept
+{
+	// Single pixels up to the 16 byte boundary, then 8 pixels per iteration with aligned stores
+	while (pStart < pEnd && (reinterpret_cast<uintptr_t>(pStart) & 15u) != 0u)
+	{
+		*pStart++ = c;
+	}
+	const __m128i value = _mm_set1_epi32((int)c.dword);
+	for (; pEnd - pStart >= 8; pStart += 8)
+	{
+		_mm_store_si128(reinterpret_cast<__m128i*>(pStart), value);
+		_mm_store_si128(reinterpret_cast<__m128i*>(pStart + 4), value);
+	}
+	for (; pStart < pEnd; pStart++)
+	{
+		*pStart = c;
+	}
+}
+#endif
+
+void Surface::FillSpan(Color* pRow, int xStart, int xEnd, Color c) noexcept
+{
+	if (xStart >= xEnd)
+	{
+		return;
+	}
+#ifdef TESLA_SIMD_X86
+	if (TeslaCPU::HasSSE2())
+	{
+		FillSpanSSE2(pRow + xStart, pRow + xEnd, c);
+		return;
+	}
+#endif
+	std::fill(pRow + xStart, pRow + xEnd, c);
+}
+
+// x * y / 255 rounded to nearest for bytes, exact and cheap in 16 bit lanes
+static unsigned int MulDiv255(unsigned int x, unsigned int y) noexcept
+{
+	const unsigned int t = x * y + 128u;
+	return (t + (t >> 8u)) >> 8u;
+}
+
+Color Surface::Blend(Color dst, Color src, BlendMode mode) noexcept
+{
+	unsigned int result = 0u;
+	for (unsigned int shift = 0u; shift < 32u; shift += 8u)
+	{
+		const unsigned int d = (dst.dword >> shift) & 0xFFu;
+		const unsigned int s = (src.dword >> shift) & 0xFFu;
+		unsigned int r = s;
+		switch (mode)
+		{
+		case BlendMode::Alpha:
+			r = std::min(s + MulDiv255(d, 255u - src.GetX()), 255u);
+			break;
+		case BlendMode::Additive:
+			r = std::min(s + d, 255u);
+			break;
+		case BlendMode::Multiply:
+			r = MulDiv255(d, s);
+			break;
+		case BlendMode::Opaque:
+			break;
+		}
+		result |= r << shift;
+	}
+	return Color(result);
+}
+
+// Keyed source colors (RGB equal to the color key) leave their destination pixel unchanged
+static bool IsKeyed(Color src, unsigned int key) noexcept
+{
+	return (src.dword & 0xFFFFFFu) == key;
+}
+
+#ifdef TESLA_SIMD_X86
+// The SIMD blends widen the bytes to 16 bit lanes and do the very same integer math
+// as Surface::Blend, so every path gives bit-identical results
+template<Surface::BlendMode mode>
+TESLA_TARGET_SSE2 static __m128i Blend4SSE2(__m128i dst, __m128i src) noexcept
+{
+	if constexpr (mode == Surface::BlendMode::Opaque)
+	{
+		return src;
+	}
+	else if constexpr (mode == Surface::BlendMode::Additive)
+	{
+		return _mm_adds_epu8(src, dst);
+	}
+	else
+	{
+		const __m128i zero = _mm_setzero_si128();
+		auto MulDiv255 = [&](__m128i x, __m128i y) TESLA_TARGET_SSE2
+		{
+			const __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+			return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+		};
+		// Per pixel factor: 255 - alpha broadcast to the 4 lanes of the pixel, or src itself
+		auto Factor = [&](__m128i s16) TESLA_TARGET_SSE2
+		{
+			if constexpr (mode == Surface::BlendMode::Alpha)
+			{
+				const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xFF), 0xFF);
+				return _mm_sub_epi16(_mm_set1_epi16(255), a);
+			}
+			else
+			{
+				return s16;
+			}
+		};
+		const __m128i dLo = _mm_unpacklo_epi8(dst, zero);
+		const __m128i dHi = _mm_unpackhi_epi8(dst, zero);
+		const __m128i sLo = _mm_unpacklo_epi8(src, zero);
+		const __m128i sHi = _mm_unpackhi_epi8(src, zero);
+		const __m128i r = _mm_packus_epi16(MulDiv255(dLo, Factor(sLo)), MulDiv255(dHi, Factor(sHi)));
+		if constexpr (mode == Surface::BlendMode::Alpha)
+		{
+			return _mm_adds_epu8(src, r);
+		}
+		else
+		{
+			return r;
+		}
+	}
+}
+
+template<Surface::BlendMode mode>
+TESLA_TARGET_AVX2 static __m256i Blend8AVX2(__m256i dst, __m256i src) noexcept
+{
+	if constexpr (mode == Surface::BlendMode::Opaque)
+	{
+		return src;
+	}
+	else if constexpr (mode == Surface::BlendMode::Additive)
+	{
+		return _mm256_adds_epu8(src, dst);
+	}
+	else
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		auto MulDiv255 = [&](__m256i x, __m256i y) TESLA_TARGET_AVX2
+		{
+			const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, y), _mm256_set1_epi16(128));
+			return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+		};
+		auto Factor = [&](__m256i s16) TESLA_TARGET_AVX2
+		{
+			if constexpr (mode == Surface::BlendMode::Alpha)
+			{
+				const __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, 0xFF), 0xFF);
+				return _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+			}
+			else
+			{
+				return s16;
+			}
+		};
+		// Unpack and pack work inside 128 bit lanes, so the pixels come back in place
+		const __m256i dLo = _mm256_unpacklo_epi8(dst, zero);
+		const __m256i dHi = _mm256_unpackhi_epi8(dst, zero);
+		const __m256i sLo = _mm256_unpacklo_epi8(src, zero);
+		const __m256i sHi = _mm256_unpackhi_epi8(src, zero);
+		const __m256i r = _mm256_packus_epi16(MulDiv255(dLo, Factor(sLo)), MulDiv255(dHi, Factor(sHi)));
+		if constexpr (mode == Surface::BlendMode::Alpha)
+		{
+			return _mm256_adds_epu8(src, r);
+		}
+		else
+		{
+			return r;
+		}
+	}
+}
+
+// uniform: pSrc points to a single color blended into every pixel. keyed: the source colors
+// matching key (RGB only) are skipped, by selecting dst back in the SIMD paths
+template<Surface::BlendMode mode, bool uniform, bool keyed>
+TESLA_TARGET_SSE2 static void BlendSpanSSE2(Color* pDst, const Color* pSrc, int count, unsigned int key) noexcept
+{
+	const __m128i srcUniform = _mm_set1_epi32((int)pSrc->dword);
+	const __m128i rgbMask    = _mm_set1_epi32(0xFFFFFF);
+	const __m128i keyRGB     = _mm_set1_epi32((int)key);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i src = uniform ? srcUniform : _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+		__m128i* const p  = reinterpret_cast<__m128i*>(pDst + i);
+		const __m128i dst = _mm_loadu_si128(p);
+		__m128i r = Blend4SSE2<mode>(dst, src);
+		if constexpr (keyed)
+		{
+			const __m128i skip = _mm_cmpeq_epi32(_mm_and_si128(src, rgbMask), keyRGB);
+			r = _mm_or_si128(_mm_and_si128(skip, dst), _mm_andnot_si128(skip, r));
+		}
+		_mm_storeu_si128(p, r);
+	}
+	for (; i < count; i++)
+	{
+		const Color src = uniform ? *pSrc : pSrc[i];
+		if (!keyed || !IsKeyed(src, key))
+		{
+			pDst[i] = Surface::Blend(pDst[i], src, mode);
+		}
+	}
+}
+
+template<Surface::BlendMode mode, bool uniform, bool keyed>
+TESLA_TARGET_AVX2 static void BlendSpanAVX2(Color* pDst, const Color* pSrc, int count, unsigned int key) noexcept
+{
+	const __m256i srcUniform = _mm256_set1_epi32((int)pSrc->dword);
+	const __m256i rgbMask    = _mm256_set1_epi32(0xFFFFFF);
+	const __m256i keyRGB     = _mm256_set1_epi32((int)key);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i src = uniform ? srcUniform : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+		__m256i* const p  = reinterpret_cast<__m256i*>(pDst + i);
+		const __m256i dst = _mm256_loadu_si256(p);
+		__m256i r = Blend8AVX2<mode>(dst, src);
+		if constexpr (keyed)
+		{
+			r = _mm256_blendv_epi8(r, dst, _mm256_cmpeq_epi32(_mm256_and_si256(src, rgbMask), keyRGB));
+		}
+		_mm256_storeu_si256(p, r);
+	}
+	for (; i < count; i++)
+	{
+		const Color src = uniform ? *pSrc : pSrc[i];
+		if (!keyed || !IsKeyed(src, key))
+		{
+			pDst[i] = Surface::Blend(pDst[i], src, mode);
+		}
+	}
+	_mm256_zeroupper();
+}
+#endif
+
+template<Surface::BlendMode mode, bool uniform, bool keyed>
+static void BlendSpanDispatch(Color* pDst, const Color* pSrc, int count, unsigned int key) noexcept
+{
+#ifdef TESLA_SIMD_X86
+	if (TeslaCPU::HasAVX2())
+	{
+		BlendSpanAVX2<mode, uniform, keyed>(pDst, pSrc, count, key);
+		return;
+	}
+	if (TeslaCPU::HasSSE2())
+	{
+		BlendSpanSSE2<mode, uniform, keyed>(pDst, pSrc, count, key);
+		return;
+	}
+#endif
+	for (int i = 0; i < count; i++)
+	{
+		const Color src = uniform ? *pSrc : pSrc[i];
+		if (!keyed || !IsKeyed(src, key))
+		{
+			pDst[i] = Surface::Blend(pDst[i], src, mode);
+		}
+	}
+}
+
+template<bool uniform, bool keyed = false>
+static void BlendSpanImpl(Color* pDst, const Color* pSrc, int count, Surface::BlendMode mode, unsigned int key = 0u) noexcept
+{
+	switch (mode)
+	{
+	case Surface::BlendMode::Alpha:
+		BlendSpanDispatch<Surface::BlendMode::Alpha, uniform, keyed>(pDst, pSrc, count, key);
+		break;
+	case Surface::BlendMode::Additive:
+		BlendSpanDispatch<Surface::BlendMode::Additive, uniform, keyed>(pDst, pSrc, count, key);
+		break;
+	case Surface::BlendMode::Multiply:
+		BlendSpanDispatch<Surface::BlendMode::Multiply, uniform, keyed>(pDst, pSrc, count, key);
+		break;
+	case Surface::BlendMode::Opaque:
+		if constexpr (keyed)
+		{
+			BlendSpanDispatch<Surface::BlendMode::Opaque, uniform, keyed>(pDst, pSrc, count, key);
+		}
+		else if constexpr (uniform)
+		{
+			Surface::FillSpan(pDst, 0, count, *pSrc);
+		}
+		else
+		{
+			std::copy(pSrc, pSrc + count, pDst);
+		}
+		break;
+	}
+}
+
+void Surface::BlendSpan(Color* pRow, int xStart, int xEnd, Color c, BlendMode mode) noexcept
+{
+	if (xStart < xEnd)
+	{
+		BlendSpanImpl<true>(pRow + xStart, &c, xEnd - xStart, mode);
+	}
+}
+
+void Surface::BlendSpan(Color* pDst, const Color* pSrc, int count, BlendMode mode) noexcept
+{
+	if (count > 0)
+	{
+		BlendSpanImpl<false>(pDst, pSrc, count, mode);
+	}
+}
+
+void Surface::BlendSpan(Color* pDst, const Color* pSrc, int count, Color chroma, BlendMode mode) noexcept
+{
+	if (count > 0)
+	{
+		BlendSpanImpl<false, true>(pDst, pSrc, count, mode, chroma.dword & 0xFFFFFFu);
+	}
+}
+
 unsigned int Surface::GetRowPitch() const noexcept
 {
 	return width * sizeof(Color);
@@ -119,7 +678,36 @@ unsigned int Surface::GetPixelCount() const noexcept
 	return width * height;
 }
 
-Surface Surface::FromFile(const std::string& filename)
+void Surface::Copy(const Surface& src) noexcept
+{
+	assert(width == src.width);
+	assert(height == src.height);
+	assert(layout == src.layout);
+	std::copy_n(src.pBuffer.get(), LayoutPixelCount(width, height, layout), pBuffer.get());
+}
+
+void Surface::Copy(const Surface& src, const Rect& rect) noexcept
+{
+	assert(width == src.width);
+	assert(height == src.height);
+	assert(layout == Layout::Linear && src.layout == Layout::Linear && "Row access to a tiled surface");
+	const int left   = std::max(rect.left, 0);
+	const int top    = std::max(rect.top, 0);
+	const int right  = std::min(rect.right, (int)width);
+	const int bottom = std::min(rect.bottom, (int)height);
+	if (left >= right)
+	{
+		return;
+	}
+	for (int y = top; y < bottom; y++)
+	{
+		const size_t offset = (size_t)width * y + left;
+		std::copy_n(&src.pBuffer[offset], right - left, &pBuffer[offset]);
+	}
+}
+
+#ifdef _WIN32
+Surface Surface::FromFile(const std::string& filename, Layout layout)
 {
 	// Increase the reference count on GDIPlus cause you need it 
 	// (will be decreased when we go out of scope)
@@ -164,11 +752,14 @@ Surface Surface::FromFile(const std::string& filename)
 		}
 	}
 
-	return Surface(width, height, std::move(pBuffer));
+	Surface surface(width, height, std::move(pBuffer));
+	surface.SetLayout(layout);
+	return surface;
 }
 
 void Surface::Save(const std::string& filename) const
 {
+	assert(layout == Layout::Linear && "Row access to a tiled surface");
 	GDIPlusManager gdipm;
 
 	// Not so easy stuff.
@@ -229,13 +820,6 @@ void Surface::Save(const std::string& filename) const
 	}
 }
 
-void Surface::Copy(const Surface& src) noexcept
-{
-	assert(width == src.width);
-	assert(height == src.height);
-	memcpy(pBuffer.get(), src.pBuffer.get(), (size_t)width * height * sizeof(Color));
-}
-
 /*************************************************************************************/
 /************************ GDIPlus Initialization Manager *****************************/
 unsigned long long Surface::GDIPlusManager::token = 0;
@@ -260,6 +844,60 @@ Surface::GDIPlusManager::~GDIPlusManager()
 		Gdiplus::GdiplusShutdown(token);
 	}
 }
+#else
+Surface Surface::FromFile(const std::string& filename, [[maybe_unused]] Layout layout)
+{
+	std::stringstream ss;
+	ss << "Loading image [" << filename << "]: image loading requires GDIPlus (Windows only).";
+	throw Exception(__LINE__, __FILE__, ss.str());
+}
+
+void Surface::Save(const std::string& filename) const
+{
+	assert(layout == Layout::Linear && "Row access to a tiled surface");
+	// Minimal 32bpp bottom-up BMP writer, enough for headless output
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::stringstream ss;
+		ss << "Saving surface to [" << filename << "]: failed to open the file.";
+		throw Exception(__LINE__, __FILE__, ss.str());
+	}
+
+	auto Write16 = [&file](unsigned short v) { file.put(char(v & 0xFFu)).put(char(v >> 8u)); };
+	auto Write32 = [&file](unsigned int v) { for (int i = 0; i < 4; i++) file.put(char((v >> (8 * i)) & 0xFFu)); };
+
+	const unsigned int headerSize = 14u + 40u;
+	// BITMAPFILEHEADER
+	Write16(0x4D42u);
+	Write32(headerSize + GetBufferSize());
+	Write32(0u);
+	Write32(headerSize);
+	// BITMAPINFOHEADER
+	Write32(40u);
+	Write32(width);
+	Write32(height);
+	Write16(1u);
+	Write16(32u);
+	Write32(0u);
+	Write32(GetBufferSize());
+	Write32(2835u);
+	Write32(2835u);
+	Write32(0u);
+	Write32(0u);
+	// Color is already laid out as BGRX in memory
+	for (unsigned int y = height; y-- > 0u;)
+	{
+		file.write(reinterpret_cast<const char*>(&pBuffer[(size_t)width * y]), width * sizeof(Color));
+	}
+	if (!file)
+	{
+		std::stringstream ss;
+		ss << "Saving surface to [" << filename << "]: failed to save.";
+		throw Exception(__LINE__, __FILE__, ss.str());
+	}
+}
+#endif
 
 /***************************************************************************************/
 /********************************** EXCEPTION LAND *************************************/
@@ -2,6 +2,8 @@
 #include "TeslaException.h"
 #include <string>
 #include <memory>
+#include <span>
+#include <vector>
 #include "Color.h"
 
 // Stores an image
@@ -28,6 +30,15 @@ public:
         static unsigned long long token;
         static int refCount;
     };
+public:
+	// Rectangle of pixels, the right and bottom sides are excluded
+	struct Rect
+	{
+		int left;
+		int top;
+		int right;
+		int bottom;
+	};
 public:
     Surface() = delete;
 	Surface(unsigned int width, unsigned int height, std::unique_ptr<Color[]> pBuffer) noexcept;
@@ -38,14 +49,76 @@ public:
 	Surface& operator = (Surface&& donor) noexcept;
 	Surface& operator = (const Surface&) = delete;
     ~Surface() = default;
-    // Clear the entire Surface with the specified color
+    // Clear the entire Surface with the specified color (streaming stores on large surfaces)
 	void Clear(Color fillvalue) noexcept;
+    // Clear only a rectangle, or a list of them, clipped to the Surface
+	void ClearRect(const Rect& rect, Color fillvalue) noexcept;
+	void ClearRegions(std::span<const Rect> rects, Color fillvalue) noexcept;
     // Set the pixel at coordinates (x, y)
 	void PutPixel(int x, int y, Color c) noexcept;
     // Get the pixel at coordinates (x, y)
 	Color GetPixel(unsigned int x, unsigned int y) const noexcept;
-	// Sample the texture using normalized uv coordinates
-	Color Sample(float u, float v) const noexcept;
+	// Texture filters. Point is a clamped nearest neighbor lookup, Bilinear blends the 2x2
+	// texels around the sample and Trilinear also blends two neighboring mip levels
+	enum class Filter
+	{
+		Point,
+		Bilinear,
+		Trilinear
+	};
+	// How the texels are stored. Linear is row-major. Tiled is for read-mostly textures: 4x4
+	// texel blocks (one 64 byte cache line each) in row-major block order, so a walk through
+	// the texture in any direction misses the cache about once per 4 texels. Texel access
+	// (PutPixel, GetPixel, Sample*) and Clear work in both, row access is only for Linear
+	enum class Layout
+	{
+		Linear,
+		Tiled
+	};
+	// Where texel coordinates outside the texture land: Clamp repeats the edge texels, Wrap
+	// repeats the texture and Mirror repeats it flipped every other time
+	enum class AddressMode
+	{
+		Clamp,
+		Wrap,
+		Mirror
+	};
+	// One level of the mip chain, level 0 is the Surface itself
+	struct MipLevel
+	{
+		const Color* pPixels;
+		unsigned int width;
+		unsigned int height;
+		Layout layout;
+		// Texels from a row to the next one (Linear) or from a row of blocks to the next one (Tiled)
+		unsigned int pitch;
+		// Texel (x, y) is at pPixels[RowOffset(y) + ColumnOffset(x)] in both layouts
+		size_t RowOffset(unsigned int y) const noexcept
+		{
+			return layout == Layout::Tiled ? size_t(y >> 2u) * pitch + ((y & 3u) << 2u) : size_t(y) * pitch;
+		}
+		size_t ColumnOffset(unsigned int x) const noexcept
+		{
+			return layout == Layout::Tiled ? ((x >> 2u) << 4u) + (x & 3u) : x;
+		}
+	};
+	// Rearrange the texels (and the mip chain) into another layout
+	void SetLayout(Layout newLayout);
+	Layout GetLayout() const noexcept;
+	// Build the mip chain down to 1x1, every texel averages 2x2 texels of the level above.
+	// The chain is a snapshot: build it again after changing the pixels
+	void GenerateMips();
+	void ReleaseMips() noexcept;
+	// Number of levels, 1 when there is no mip chain
+	unsigned int GetMipCount() const noexcept;
+	MipLevel GetMip(unsigned int level) const noexcept;
+	// Sample a level of the texture using normalized uv coordinates, u = 1 is the center of
+	// the last column. The trilinear weight of level + 1 is in 1/256 units
+	Color Sample(float u, float v, unsigned int level = 0u) const noexcept;
+	Color SampleBilinear(float u, float v, unsigned int level = 0u) const noexcept;
+	Color SampleTrilinear(float u, float v, unsigned int level, unsigned int weight) const noexcept;
+	// Per byte a + (b - a) * weight / 256, weight in [0, 256]
+	static Color Lerp(Color a, Color b, unsigned int weight) noexcept;
     // Get the Surface width (in pixels)
 	unsigned int GetWidth() const noexcept;
     // Get the Surface height (in pixels)
@@ -54,20 +127,49 @@ public:
 	Color* GetBufferPtr() const noexcept;
     // Get a constant pointer to the color buffer
 	const Color* GetBufferPtrConst() const noexcept;
+    // Get a pointer to the first pixel of row y
+	Color* GetRowPtr(unsigned int y) const noexcept;
+    // Fill the half-open span [xStart, xEnd) of a row with the specified color, using wide stores
+	static void FillSpan(Color* pRow, int xStart, int xEnd, Color c) noexcept;
+    // How a color is combined with the pixel it lands on. Alpha is "over" with premultiplied
+    // alpha in the X byte: dst = src + dst * (255 - a) / 255. Additive is a saturated sum and
+    // Multiply scales dst by src / 255. All four bytes (X too) go through the same math
+	enum class BlendMode
+	{
+		Opaque,
+		Alpha,
+		Additive,
+		Multiply
+	};
+    // Blend one pixel
+	static Color Blend(Color dst, Color src, BlendMode mode) noexcept;
+    // Blend a color into the half-open span [xStart, xEnd) of a row, 4 (SSE2) or 8 (AVX2) pixels at a time
+	static void BlendSpan(Color* pRow, int xStart, int xEnd, Color c, BlendMode mode) noexcept;
+    // Blend count colors from pSrc into pDst, pixel by pixel
+	static void BlendSpan(Color* pDst, const Color* pSrc, int count, BlendMode mode) noexcept;
+    // Same, skipping the source colors whose RGB equals the color key (the X bytes are ignored)
+	static void BlendSpan(Color* pDst, const Color* pSrc, int count, Color chroma, BlendMode mode) noexcept;
 	// Get the Row Pitch in bytes
 	unsigned int GetRowPitch() const noexcept;
     // Get the number bytes in the Surface
     unsigned int GetBufferSize() const noexcept;
     // Get the number of Pixels in the Surface
     unsigned int GetPixelCount() const noexcept;
-	// Load surface from an image file (bmp, png, jpg, etc.)
-	static Surface FromFile(const std::string& filename);
+	// Load surface from an image file (bmp, png, jpg, etc.), converted to the layout
+	static Surface FromFile(const std::string& filename, Layout layout = Layout::Linear);
     // Save the Surface to a file (only .bmp)
 	void Save(const std::string& filename) const;
     // Copy from another Surface having the same size
 	void Copy(const Surface& src) noexcept;
+    // Copy only a rectangle from another Surface having the same size
+	void Copy(const Surface& src, const Rect& rect) noexcept;
 private:
 	std::unique_ptr<Color[]> pBuffer;
 	unsigned int width;
 	unsigned int height;
+	Layout layout = Layout::Linear;
+	size_t TexelOffset(unsigned int x, unsigned int y) const noexcept;
+	// Levels 1 and below of the mip chain, all in one allocation
+	std::unique_ptr<Color[]> pMipBuffer;
+	std::vector<MipLevel> mips;
 };
\ No newline at end of file
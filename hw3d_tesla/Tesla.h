@@ -1,5 +1,10 @@
 #pragma once
+#ifdef _WIN32
 #include <DirectXMath.h>
+#endif
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -55,13 +60,13 @@ namespace Tesla
 		{
 			hueRad += twoPI;
 		}
-		float hue = std::fmodf(hueRad * (180.0f / PI), 360.0f);
+		float hue = std::fmod(hueRad * (180.0f / PI), 360.0f);
 
 		assert(hue >= 0.0f);
 		assert(hue < 360.0f);
 
 		const float c = value * saturation;
-		const float magic = 1.0f - std::abs(std::fmodf(hue / 60.0f, 2.0f) - 1.0f);
+		const float magic = 1.0f - std::abs(std::fmod(hue / 60.0f, 2.0f) - 1.0f);
 		const float x = c * magic;
 		const float m = value - c;
 
@@ -108,6 +113,7 @@ namespace Tesla
 			assert(vertices.size() > 2 && "There are not enough vertices in the loaded IndexedTriangleList.");
 			assert(indices.size() % 3 == 0 && "This is not an IndexedTriangleList! The Number of indices is not a multiple of 3.");
 		}
+#ifdef _WIN32
 		IndexedTriangleList& Transform(const DirectX::XMMATRIX transformation)
 		{
 			// apply the transformation matrix to every vertex position
@@ -142,6 +148,7 @@ namespace Tesla
 
 			return *this;
 		}
+#endif
 	public:
 		std::vector<index_type> indices;
 		std::vector<Vertex> vertices;
@@ -161,6 +168,7 @@ namespace Tesla
 			assert(indices.size() >= 2 && "There are not enough indices in the loaded IndexedLineList!");
 			assert(indices.size() % 2 == 0 && "This is not an IndexedLineList! The number of indices must be even");
 		}
+#ifdef _WIN32
 		IndexedLineList& Transform(const DirectX::XMMATRIX transformation)
 		{
 			// apply the transformation matrix to every vertex position
@@ -170,6 +178,7 @@ namespace Tesla
 			}
 			return *this;
 		}
+#endif
 	public:
 		std::vector<index_type> indices;
 		std::vector<Vertex> vertices;
@@ -477,8 +486,7 @@ namespace Tesla
 		template<typename S>
 		explicit Generic_Vec3(const Generic_Vec3<S>& other)
 			:
-			Generic_Vec3((T)other.x, (T)other.y),
-			z((T)other.z)
+			Generic_Vec3((T)other.x, (T)other.y, (T)other.z)
 		{}
 	public:
 		T z;
@@ -601,7 +609,7 @@ namespace Tesla
 		}
 		T GetLength() const
 		{
-			return std::sqrtf(GetLengthSq());
+			return (T)std::sqrt(GetLengthSq());
 		}
 		Generic_Vec4& Normalize()
 		{
@@ -615,7 +623,7 @@ namespace Tesla
 		template<typename S>
 		explicit Generic_Vec4(const Generic_Vec4<S>& other)
 			:
-			Generic_Vec3((T)other.x, (T)other.y, (T)other.z),
+			Generic_Vec3<T>((T)other.x, (T)other.y, (T)other.z),
 			w((T)other.w)
 		{}
 	public:
@@ -988,6 +996,8 @@ public:
 
 	namespace Geometry
 	{
+#ifdef _WIN32
+		// The meshes built from DirectXMath types only exist where DirectXMath does
 		class Cube
 		{
 		public:
@@ -1398,6 +1408,7 @@ public:
 				return grid;
 			}
 		};
+#endif
 
 		class Plane
 		{
@@ -1564,6 +1575,7 @@ public:
 			}
 		};
 
+#ifdef _WIN32
 		class Sphere
 		{
 		public:
@@ -1590,9 +1602,9 @@ public:
 				// utility lambda
 				auto fromPolar = [](const float phi, const float theta)
 				{
-					const float x = std::sinf(phi) * std::cosf(theta);
-					const float y = std::sinf(phi) * std::sinf(theta);
-					const float z = std::cosf(phi);
+					const float x = std::sin(phi) * std::cos(theta);
+					const float y = std::sin(phi) * std::sin(theta);
+					const float z = std::cos(phi);
 					return DirectX::XMFLOAT3(x, y, z);
 				};
 
@@ -1979,6 +1991,7 @@ public:
 			}
 
 		};
+#endif
 
 		class OBJModel
 		{
@@ -2043,7 +2056,7 @@ public:
 				}
 				else
 				{
-					throw std::exception(("Couldn't open the specified file: " + filename).c_str());
+					throw std::runtime_error("Couldn't open the specified file: " + filename);
 				}
 			}
 		private:
@@ -2284,7 +2297,7 @@ public:
 				}
 				else
 				{
-					throw std::exception((std::string("The loaded file doesn't have normals! ") + filename).c_str());
+					throw std::runtime_error(std::string("The loaded file doesn't have normals! ") + filename);
 				}
 
 				return { std::move(vertices),std::move(indices) };
@@ -2330,7 +2343,7 @@ public:
 				}
 				else
 				{
-					throw std::exception((std::string("The loaded file doesn't have texture coordinates! ") + filename).c_str());
+					throw std::runtime_error(std::string("The loaded file doesn't have texture coordinates! ") + filename);
 				}
 			}
 	
@@ -2381,15 +2394,15 @@ public:
 				{
 					if (!mesh.hasNormals && !mesh.hasTexCoords)
 					{
-						throw std::exception((std::string("The loaded file doesn't have normals and texture coordinates! ") + filename).c_str());
+						throw std::runtime_error(std::string("The loaded file doesn't have normals and texture coordinates! ") + filename);
 					}
 					if (!mesh.hasNormals && mesh.hasTexCoords)
 					{
-						throw std::exception((std::string("The loaded file doesn't have normals! ") + filename).c_str());
+						throw std::runtime_error(std::string("The loaded file doesn't have normals! ") + filename);
 					}
 					if (mesh.hasNormals && !mesh.hasTexCoords)
 					{
-						throw std::exception((std::string("The loaded file doesn't have texture coordinates! ") + filename).c_str());
+						throw std::runtime_error(std::string("The loaded file doesn't have texture coordinates! ") + filename);
 					}
 				}
 				return { std::move(vertices),std::move(indices) };
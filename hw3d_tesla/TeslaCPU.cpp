@@ -0,0 +1,50 @@
+#include "TeslaCPU.h"
+#ifdef TESLA_SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+bool TeslaCPU::HasSSE2() noexcept
+{
+	return GetFeatures().sse2;
+}
+
+bool TeslaCPU::HasAVX2() noexcept
+{
+	return GetFeatures().avx2;
+}
+
+const TeslaCPU::Features& TeslaCPU::GetFeatures() noexcept
+{
+	static const Features features = []
+	{
+		Features f;
+#ifdef TESLA_SIMD_X86
+#ifdef _MSC_VER
+		int info[4] = {};
+		__cpuid(info, 0);
+		const int nIds = info[0];
+
+		__cpuid(info, 1);
+		f.sse2 = (info[3] & (1 << 26)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx     = (info[2] & (1 << 28)) != 0;
+
+		// AVX registers are only usable if the OS saves the YMM state on context switches
+		if (nIds >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			__cpuidex(info, 7, 0);
+			f.avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		f.sse2 = __builtin_cpu_supports("sse2");
+		f.avx2 = __builtin_cpu_supports("avx2");
+#endif
+#endif
+		return f;
+	}();
+	return features;
+}
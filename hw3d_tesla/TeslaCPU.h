@@ -0,0 +1,31 @@
+#pragma once
+
+// The x86 SIMD code paths are compiled in unless TESLA_NO_SIMD is defined,
+// every other architecture always takes the scalar paths
+#if !defined(TESLA_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define TESLA_SIMD_X86
+#endif
+
+// MSVC accepts any intrinsic in any function, GCC and Clang need the target spelled out
+#if defined(__GNUC__) || defined(__clang__)
+#define TESLA_TARGET_SSE2 __attribute__((target("sse2")))
+#define TESLA_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TESLA_TARGET_SSE2
+#define TESLA_TARGET_AVX2
+#endif
+
+// Runtime detection of the instruction sets the SIMD kernels are built for
+class TeslaCPU
+{
+public:
+	static bool HasSSE2() noexcept;
+	static bool HasAVX2() noexcept;
+private:
+	struct Features
+	{
+		bool sse2 = false;
+		bool avx2 = false;
+	};
+	static const Features& GetFeatures() noexcept;
+};
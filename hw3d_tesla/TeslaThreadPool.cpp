@@ -0,0 +1,92 @@
+#include "TeslaThreadPool.h"
+#include <algorithm>
+
+TeslaThreadPool::TeslaThreadPool(unsigned int nThreads)
+{
+	nThreads = std::max(nThreads, 1u);
+	for (unsigned int i = 1u; i < nThreads; i++)
+	{
+		workers.emplace_back(&TeslaThreadPool::WorkerLoop, this);
+	}
+}
+
+TeslaThreadPool::~TeslaThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		quit = true;
+	}
+	cvStart.notify_all();
+	for (auto& w : workers)
+	{
+		w.join();
+	}
+}
+
+void TeslaThreadPool::ParallelFor(unsigned int nTasks_in, const std::function<void(unsigned int)>& task)
+{
+	if (workers.empty() || nTasks_in <= 1u)
+	{
+		for (unsigned int i = 0u; i < nTasks_in; i++)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		pTask = &task;
+		nTasks = nTasks_in;
+		nextTask = 0u;
+		nBusyWorkers = (unsigned int)workers.size();
+		generation++;
+	}
+	cvStart.notify_all();
+
+	// The calling thread steals work as well instead of just waiting
+	RunTasks();
+
+	std::unique_lock<std::mutex> lock(mtx);
+	cvDone.wait(lock, [this] { return nBusyWorkers == 0u; });
+	pTask = nullptr;
+}
+
+unsigned int TeslaThreadPool::GetThreadCount() const noexcept
+{
+	return (unsigned int)workers.size() + 1u;
+}
+
+void TeslaThreadPool::WorkerLoop()
+{
+	unsigned long long lastGeneration = 0u;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cvStart.wait(lock, [&] { return quit || generation != lastGeneration; });
+			if (quit)
+			{
+				return;
+			}
+			lastGeneration = generation;
+		}
+
+		RunTasks();
+
+		std::lock_guard<std::mutex> lock(mtx);
+		if (--nBusyWorkers == 0u)
+		{
+			cvDone.notify_one();
+		}
+	}
+}
+
+void TeslaThreadPool::RunTasks()
+{
+	// Tasks are handed out one at a time, so uneven tasks still balance well
+	for (unsigned int i = nextTask++; i < nTasks; i = nextTask++)
+	{
+		(*pTask)(i);
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Fixed pool of worker threads that run data-parallel loops
+class TeslaThreadPool
+{
+public:
+	// nThreads counts the calling thread too, so nThreads - 1 workers are spawned
+	TeslaThreadPool(unsigned int nThreads = std::thread::hardware_concurrency());
+	TeslaThreadPool(const TeslaThreadPool&) = delete;
+	TeslaThreadPool& operator = (const TeslaThreadPool&) = delete;
+	~TeslaThreadPool();
+	// Run task(i) for every i in [0, nTasks) and return when all of them are done
+	void ParallelFor(unsigned int nTasks, const std::function<void(unsigned int)>& task);
+	unsigned int GetThreadCount() const noexcept;
+private:
+	void WorkerLoop();
+	void RunTasks();
+private:
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable cvStart;
+	std::condition_variable cvDone;
+	const std::function<void(unsigned int)>* pTask = nullptr;
+	unsigned int nTasks = 0u;
+	std::atomic<unsigned int> nextTask{ 0u };
+	unsigned int nBusyWorkers = 0u;
+	unsigned long long generation = 0u;
+	bool quit = false;
+};